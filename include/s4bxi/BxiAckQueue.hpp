@@ -0,0 +1,60 @@
+/*
+ * Author: Julien EMMANUEL
+ * Copyright (C) 2019-2022 Bull S.A.S
+ * All rights reserved
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation,
+ * which comes with this package.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+
+#ifndef S4BXI_BXIACKQUEUE_HPP
+#define S4BXI_BXIACKQUEUE_HPP
+
+#include <cstdint>
+#include <queue>
+#include <vector>
+
+#include "s4ptl.hpp"
+
+/**
+ * @brief ACKs that are modeled analytically, waiting to be delivered at their initiator
+ *
+ * Instead of being sent through the network, an ACK is given a delivery date
+ * (computed from the route between the two NICs) and put in the queue of its
+ * destination. `get` blocks until the earliest ACK is due, so it can be used
+ * just like a BxiQueue by the actor that processes these ACKs. ACKs going
+ * to the same node don't necessarily arrive in the order they were sent, so
+ * they are kept in a heap (ties are broken in sending order)
+ */
+class BxiAckQueue {
+    struct Entry {
+        double date;
+        uint64_t seq;
+        BxiMsg* msg;
+
+        bool operator>(const Entry& other) const { return date > other.date || (date == other.date && seq > other.seq); }
+    };
+
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> pending;
+    simgrid::s4u::SemaphorePtr wakeup;
+    double planned_wakeup; // When the consumer will look at the queue again (infinity if it's empty)
+    uint64_t next_seq = 0;
+
+  public:
+    BxiAckQueue();
+
+    void put(BxiMsg* msg, double date);
+    BxiMsg* get();
+    bool empty() const { return pending.empty(); }
+    void clear();
+};
+
+#endif // S4BXI_BXIACKQUEUE_HPP
@@ -17,28 +17,58 @@
 #ifndef S4BXI_BxiEngine_HPP
 #define S4BXI_BxiEngine_HPP
 
+#include <array>
 #include <map>
 #include <set>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include <cstring>
 #include <iostream>
-#include <fstream>
 
 #include "BxiNode.hpp"
 #include "BxiLog.hpp"
+#include "BxiTrace.hpp"
+#include "BxiStats.hpp"
 #include "s4bxi_config.hpp"
 #include "s4bxi_util.hpp"
 
 class BxiMainActor;
 
+/**
+ * @brief Which events are logged, precomputed from S4BXI_LOG_NIDS, S4BXI_LOG_TYPES,
+ * S4BXI_LOG_WINDOW and S4BXI_LOG_COMPUTATION
+ */
+struct bxi_log_filter {
+    std::vector<uint32_t> nid_masks; // Bit `type` is set if events of this type are logged for this NID
+    uint32_t default_mask = 0;       // For NIDs that are not in nid_masks
+    bool windowed         = false;
+    double window_start   = 0;
+    double window_end     = 0;
+};
+
 class BxiEngine {
     static BxiEngine* instance;
-    std::map<int, std::shared_ptr<BxiNode>> nodes;
-    std::map<aid_t, BxiMainActor*> actors;
-    std::shared_ptr<s4bxi_config> config;
-    unsigned long logCount = 0;
-    std::ofstream logFile;
+    std::vector<std::shared_ptr<BxiNode>> nodes; // Indexed by NID
+    std::unordered_map<aid_t, BxiMainActor*> actors;
+    // Registry of the ranks, filled once when each rank starts
+    std::vector<BxiMainActor*> actors_by_rank;
+    std::unordered_map<std::string, std::vector<BxiMainActor*>> actors_by_slug; // Indexed by local rank
+    static s4bxi_config config; // Snapshot hydrated once by the constructor
+    static bxi_log_filter log_filter;
+    bool tracing = false;
+    std::unique_ptr<BxiTrace> trace; // Opened by the first log
+    std::unique_ptr<BxiStats> stats;
     std::string simulation_rand_id = "0000000000";
+    // Dense [nid][vn] tables of the NIC mailboxes
+    std::vector<std::array<simgrid::s4u::Mailbox*, 4>> nic_rx_mailboxes;
+    std::vector<std::array<simgrid::s4u::Mailbox*, 4>> nic_tx_mailboxes;
+
+    void add_node_mailboxes(int nid);
+    void build_log_filter();
+    void log_loss_stats();
+    void log_ack_stats();
+    void log_pci_stats();
 
     BxiEngine();
 
@@ -59,16 +89,43 @@ class BxiEngine {
         return instance;
     }
 
-    static std::shared_ptr<s4bxi_config> get_config();
+    /**
+     * Plain reference to the configuration snapshot, so that reading it on the hot path
+     * is a simple load. The engine must have been created (get_instance) beforehand
+     */
+    static const s4bxi_config& get_config() { return config; }
+    static void set_log_level(int level);
+
+    /**
+     * Whether an event should be logged (assuming logging is enabled at all). Only reads the
+     * clock if there is a time window
+     */
+    static bool must_log(bxi_log_type type, ptl_nid_t initiator, ptl_nid_t target)
+    {
+        const auto& f = log_filter;
+        uint32_t mask = (initiator < f.nid_masks.size() ? f.nid_masks[initiator] : f.default_mask) |
+                        (target < f.nid_masks.size() ? f.nid_masks[target] : f.default_mask);
+        if (!(mask >> type & 1))
+            return false;
+        if (!f.windowed)
+            return true;
+
+        double now = simgrid::s4u::Engine::get_clock();
+        return now >= f.window_start && now <= f.window_end;
+    }
 
     std::string get_simulation_rand_id();
     void set_simulation_rand_id(std::string id);
     std::shared_ptr<BxiNode> get_node(int);
+    void build_mailbox_tables();
+    simgrid::s4u::Mailbox* get_nic_rx_mailbox(int nid, bxi_vn vn);
+    simgrid::s4u::Mailbox* get_nic_tx_mailbox(int nid, bxi_vn vn);
     void log(const BxiLog& log);
     void end_simulation();
     void register_main_actor(BxiMainActor*);
-    std::map<aid_t, BxiMainActor*> main_actors_on_host(const std::string& hostname);
-    std::set<std::string, std::less<>> used_nodes();
+    int register_rank(BxiMainActor* actor, int rank);
+    const std::vector<BxiMainActor*>& main_actors_on_host(const std::string& hostname);
+    int get_used_node_count();
     BxiMainActor* get_current_main_actor();
     BxiMainActor* get_main_actor(aid_t pid);
     int get_main_actor_count();
@@ -43,8 +43,33 @@ enum bxi_log_type {
 
     // Compute ones
     S4BXILOG_COMPUTE,
+
+    S4BXILOG_TYPE_COUNT // Keep last
 };
 
+inline const char* bxi_log_type_name(int type)
+{
+    static const char* names[S4BXILOG_TYPE_COUNT] = {
+        "E2E_ACK",
+        "PTL_ACK",
+        "PTL_GET_RESPONSE",
+        "PTL_PUT",
+        "PTL_GET",
+        "PTL_ATOMIC",
+        "PTL_FETCH_ATOMIC",
+        "PTL_FETCH_ATOMIC_RESPONSE",
+        "PCI_PIO_PAYLOAD",
+        "PCI_DMA_PAYLOAD",
+        "PCI_DMA_REQUEST",
+        "PCI_PAYLOAD_WRITE",
+        "PCI_EVENT",
+        "PCI_COMMAND",
+        "COMPUTE",
+    };
+
+    return type >= 0 && type < S4BXILOG_TYPE_COUNT ? names[type] : "UNKNOWN";
+}
+
 class BxiLog {
   public:
     double start;
@@ -52,6 +77,7 @@ class BxiLog {
     bxi_log_type type;
     ptl_nid_t initiator;
     ptl_nid_t target;
+    ptl_size_t size = 0; // Bytes transferred, only used by S4BXI_STATS
 
     friend std::ostream& operator<<(std::ostream& os, BxiLog const& log)
     {
@@ -0,0 +1,92 @@
+/*
+ * Author: Julien EMMANUEL
+ * Copyright (C) 2019-2022 Bull S.A.S
+ * All rights reserved
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation,
+ * which comes with this package.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+
+#ifndef S4BXI_BXILOSSMODEL_HPP
+#define S4BXI_BXILOSSMODEL_HPP
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "s4ptl.hpp"
+#include "s4bxi_config.hpp"
+
+enum bxi_loss_kind { S4BXI_LOSS_NONE, S4BXI_LOSS_UNIFORM, S4BXI_LOSS_GILBERT_ELLIOTT };
+
+/**
+ * @brief Messages from a range of initiators to a range of targets are all lost during
+ * a window of simulated time, or only those whose route goes through a given link of
+ * the platform (a failed cable, switch port, etc.)
+ */
+struct bxi_link_fault {
+    ptl_nid_t src_first;
+    ptl_nid_t src_last;
+    ptl_nid_t dst_first;
+    ptl_nid_t dst_last;
+    std::string link; // Empty if the fault isn't bound to a link
+    double start;
+    double end;
+};
+
+/**
+ * @brief Injection of lost messages, on the RX side of a NIC
+ *
+ * The model is configured once for the whole simulation (see `configure`),
+ * and each node that receives messages has its own instance, with its own
+ * random generator (seeded by S4BXI_LOSS_SEED and the NID, so that runs are
+ * reproducible) and the Gilbert-Elliott state of each incoming link.
+ *
+ * Only messages that E2E can recover are dropped, i.e. messages tracked by the
+ * E2E actor of their initiator (everything but E2E ACKs)
+ */
+class BxiLossModel {
+    static bxi_loss_kind kind;
+    static double rate;          // Uniform
+    static double p_good_to_bad; // Gilbert-Elliott
+    static double p_bad_to_good;
+    static double loss_good;
+    static double loss_bad;
+    static std::vector<bxi_link_fault> faults;
+    static unsigned long seed;
+    static bool links_checked;
+
+    ptl_nid_t nid;
+    std::mt19937_64 rng;
+    std::uniform_real_distribution<double> uniform{0, 1};
+    std::vector<bool> bad_links; // Gilbert-Elliott state, indexed by initiator NID
+
+    bool is_recoverable(const BxiMsg* msg) const;
+    bool link_is_down(const BxiMsg* msg) const;
+
+  public:
+    // Statistics
+    unsigned long dropped           = 0;
+    unsigned long dropped_by_faults = 0;
+    unsigned long late_deliveries   = 0; // Retransmissions that got through
+    double added_latency            = 0; // Sum over late deliveries, in seconds
+    double max_added_latency        = 0;
+
+    explicit BxiLossModel(ptl_nid_t nid);
+
+    static void configure(const s4bxi_config& config);
+    static bool enabled() { return kind != S4BXI_LOSS_NONE || !faults.empty(); }
+
+    bool drop(const BxiMsg* msg);
+    void record_delivery(const BxiMsg* msg);
+};
+
+#endif // S4BXI_BXILOSSMODEL_HPP
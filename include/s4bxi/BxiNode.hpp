@@ -21,23 +21,81 @@
 #include <string>
 #include <vector>
 #include <deque>
+#include <unordered_map>
 
 #include "portals4.h"
 #include "s4ptl.hpp"
 #include "s4bxi/BxiLog.hpp"
 #include "s4bxi/BxiQueue.hpp"
+#include "s4bxi/BxiAckQueue.hpp"
+#include "s4bxi/BxiLossModel.hpp"
+#include "s4bxi/BxiPciModel.hpp"
 
 class BxiNicE2E;
 
-struct flowctrl_process_id {
+// PIDs above this are not stored in the dense PID -> NI table (they are still found by scanning ni_handles)
+#define DENSE_PID_TABLE_SIZE 65536
+
+/**
+ * @brief Process level flow control towards one destination node
+ *
+ * When process level flow control is disabled, there is a single flow per
+ * destination (with unlimited credits)
+ */
+struct flowctrl_flow {
     ptl_pid_t src_pid;
     ptl_pid_t dst_pid;
-    ptl_nid_t dst_nid;
-    // The struct requires an operator "<" to be usable as a std::map's key
-    bool operator<(const flowctrl_process_id& other) const
-    {
-        return std::tie(src_pid, dst_pid, dst_nid) < std::tie(other.src_pid, other.dst_pid, other.dst_nid);
-    }
+    int credits;
+    std::deque<BxiMsg*> waiting; // Blocked messages, in the order they were sent
+    bool ready = false;          // In the ready list of its destination
+};
+
+/**
+ * @brief Node level flow control towards one destination node
+ *
+ * A flow is in the ready list when it has waiting messages and process level
+ * credits, which means it is only blocked by node level credits. Releasing a
+ * credit hands it to the flow at the front of the list, and flows take turns
+ */
+struct flowctrl_destination {
+    int credits;
+    std::vector<flowctrl_flow> flows; // Only a few processes talk to each other, a linear search is fine
+    std::deque<int> ready;            // Indexes in `flows`
+};
+
+/**
+ * @brief Network route from the NIC of a node to the NIC of another one
+ */
+struct nic_route {
+    std::vector<simgrid::s4u::Link*> links;
+    double latency;   // In seconds
+    double bandwidth; // In B/s, the one of the slowest link
+};
+
+/**
+ * @brief A PCI transfer started by BxiNode::pci_transfer_async
+ *
+ * In analytic PCI mode, transfers that have the PCI link to themselves aren't
+ * simulated by SimGrid, we only know when they complete
+ */
+struct bxi_pci_transfer {
+    simgrid::s4u::CommPtr comm = nullptr;
+    double end                 = -1; // Completion date of analytic transfers
+
+    explicit operator bool() const { return comm || end >= 0; }
+    void wait() const;
+};
+
+/**
+ * @brief An async PCI transfer whose completion matters whether someone waits for it or not: to log it,
+ * or to know when the PCI link becomes idle again in analytic PCI mode
+ */
+struct watched_pci_comm {
+    simgrid::s4u::CommPtr comm;
+    bool direction;
+    bool tracked;  // Counted in the PCI transfers in flight of the node
+    bool must_log;
+    BxiLog log; // `end` is filled at completion
 };
 
 class BxiNode {
@@ -46,43 +104,78 @@ class BxiNode {
 
     std::vector<int> used_pids;
     std::vector<BxiNI*> ni_handles;
+    std::vector<BxiNI*> ni_by_pid;
     ptl_nid_t nid;
     simgrid::s4u::Host* main_host;
     simgrid::s4u::Host* nic_host;
     simgrid::s4u::SemaphorePtr e2e_entries;
     BxiNicE2E* e2e_actor                   = nullptr;
     std::shared_ptr<BxiQueue> tx_queues[4] = {nullptr, nullptr, nullptr, nullptr};
+    std::unique_ptr<BxiLossModel> loss_model; // Only if lost messages are injected
+    // ACKs delivered to this node without going through the network (only on response VNs)
+    std::shared_ptr<BxiAckQueue> ack_queues[4] = {nullptr, nullptr, nullptr, nullptr};
 
-    // Node level flow control semaphores
-    std::map<ptl_nid_t, std::shared_ptr<int>> flowctrl_node_counts[4] = {
-        std::map<ptl_nid_t, std::shared_ptr<int>>(), std::map<ptl_nid_t, std::shared_ptr<int>>(),
-        std::map<ptl_nid_t, std::shared_ptr<int>>(), std::map<ptl_nid_t, std::shared_ptr<int>>()};
-    // Process level flow control semaphores
-    std::map<flowctrl_process_id, std::shared_ptr<int>> flowctrl_process_counts[4] = {
-        std::map<flowctrl_process_id, std::shared_ptr<int>>(), std::map<flowctrl_process_id, std::shared_ptr<int>>(),
-        std::map<flowctrl_process_id, std::shared_ptr<int>>(), std::map<flowctrl_process_id, std::shared_ptr<int>>()};
-    // Process level miscellaneous things (for cycle detection and processing only)
-    std::deque<BxiMsg*> flowctrl_waiting_messages[4] = {std::deque<BxiMsg*>(), std::deque<BxiMsg*>(),
-                                                        std::deque<BxiMsg*>(), std::deque<BxiMsg*>()};
+    // Flow control credits and blocked messages, per VN and indexed by destination NID
+    std::vector<flowctrl_destination> flowctrl_destinations[4];
 
     // Params
     bool use_real_memory    = true;
     bool model_pci          = true;
     bool model_pci_commands = true;
     bool e2e_off            = true;
+    const BxiPciModel* pci;
 
     // Counters
-    unsigned long e2e_retried = 0;
-    unsigned long e2e_gave_up = 0;
+    unsigned long e2e_retried   = 0;
+    unsigned long e2e_gave_up   = 0;
+    unsigned long analytic_acks = 0;
+    unsigned long fallback_acks = 0; // Sent through the network although ACKs are modeled analytically
+    unsigned long analytic_pci  = 0;
+    unsigned long fallback_pci  = 0; // Simulated by SimGrid although PCI transfers are modeled analytically
 
+    void add_ni(BxiNI* ni);
+    void remove_ni(BxiNI* ni);
+    BxiNI* get_ni(ptl_pid_t pid) const;
+    simgrid::s4u::Mailbox* get_nic_rx_mailbox(ptl_nid_t target, bxi_vn vn) const;
+    simgrid::s4u::Mailbox* get_nic_tx_mailbox(bxi_vn vn) const;
     void pci_transfer(ptl_size_t size, bool direction, bxi_log_type type);
-    simgrid::s4u::CommPtr pci_transfer_async(ptl_size_t size, bool direction, bxi_log_type type, bool detach = false);
+    bxi_pci_transfer pci_transfer_async(ptl_size_t size, bool direction, bxi_log_type type, bool detach = false);
     simgrid::s4u::CommPtr pci_transfer_init(ptl_size_t size, bool direction, bxi_log_type type);
-    void issue_event(BxiEQ* eq, ptl_event_t* ev);
-    bool check_flowctrl(const BxiMsg* msg);
+    void issue_event(BxiEQ* eq, const ptl_event_t* ev);
+    bool check_flowctrl(BxiMsg* msg);
     void acquire_e2e_entry(const BxiMsg* msg);
     void release_e2e_entry(ptl_nid_t target_nid, bxi_vn vn, ptl_pid_t src_pid, ptl_pid_t dst_pid);
-    void resume_waiting_tx_actors(bxi_vn vn);
+    void resume_waiting_tx_actors(bxi_vn vn, flowctrl_destination& dest);
+    const nic_route& get_nic_route(ptl_nid_t target);
+    size_t pending_pci_logs() const;
+
+  private:
+    std::unordered_map<ptl_nid_t, nic_route> nic_routes; // Filled lazily, used by analytic ACKs and link faults
+    // PCI routes of the platform, indexed by direction (filled lazily)
+    nic_route pci_routes[2];
+    bool pci_routes_ready = false;
+    bool pci_contends[2]; // Some link of the route isn't a FATPIPE
+    bool pci_shared;      // Both directions go through a same link that isn't a FATPIPE
+    // PCI transfers in flight, indexed by direction (only tracked in analytic PCI mode)
+    int pci_real_transfers[2] = {0, 0};
+    double pci_busy_until[2]  = {0, 0}; // End of the last analytic transfer
+    double pci_data_from[2]   = {0, 0}; // When it's done with the latency of the route and starts sending bytes
+
+    const nic_route& get_pci_route(bool direction);
+    uint64_t pci_wire_size(ptl_size_t size, bool direction, bxi_log_type type);
+    bool pci_is_idle(bool direction);
+    double pci_analytic_transfer(uint64_t wire_size, bool direction);
+    void pci_share_analytic_transfers(bool direction);
+    // Waited for by a daemon actor of the node (started on first use), which is woken up through
+    // its mailbox when comms are added
+    std::vector<watched_pci_comm> watched_pci_comms;
+    simgrid::s4u::Mailbox* pci_watcher_mailbox = nullptr;
+
+    void watch_pci_comm(watched_pci_comm&& watched);
+    void watch_pci_comms();
+
+    flowctrl_destination& get_flowctrl_destination(bxi_vn vn, ptl_nid_t target);
+    flowctrl_flow& get_flowctrl_flow(flowctrl_destination& dest, ptl_pid_t src_pid, ptl_pid_t dst_pid);
 };
 
 #endif // S4BXI_BXINODE_HPP
\ No newline at end of file
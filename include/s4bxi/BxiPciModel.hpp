@@ -0,0 +1,61 @@
+/*
+ * Author: Julien EMMANUEL
+ * Copyright (C) 2019-2022 Bull S.A.S
+ * All rights reserved
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation,
+ * which comes with this package.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+
+#ifndef S4BXI_BXIPCIMODEL_HPP
+#define S4BXI_BXIPCIMODEL_HPP
+
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Model of the PCIe link between the CPU and the NIC of a node
+ *
+ * Payloads are cut into TLPs of at most `mps` bytes (or, for DMA reads, requested
+ * by chunks of at most `mrrs` bytes), and each TLP costs `tlp_overhead` bytes on
+ * the wire (framing, sequence number, header and LCRC). The link's raw bandwidth
+ * comes from its generation and width, minus the line encoding and the share
+ * used by DLLPs (ACKs and flow control updates).
+ *
+ * The `default` model reproduces the historical behaviour of S4BXI: no TLP
+ * overhead, and transfers use the PCI links of the platform as they are. Other
+ * models rescale the transfers so that an idle PCI link of the platform goes at
+ * the model's bandwidth (contention between transfers is still handled by SimGrid)
+ */
+class BxiPciModel {
+  public:
+    std::string name;
+    double transfer_rate;  // In GT/s per lane
+    double encoding;       // Payload bits per line bit
+    int lanes;
+    int mps;               // Max payload size, in bytes
+    int mrrs;              // Max read request size, in bytes
+    int tlp_overhead;      // In bytes, for each TLP carrying data
+    int read_request_size; // In bytes, size of a memory read request TLP on the wire
+    double dllp_overhead;  // Fraction of the link used by DLLPs
+    double latency;        // In seconds, for a TLP to cross the link (including the root complex and the NIC)
+    bool rescale;          // Make transfers go at the model's bandwidth instead of the platform's
+
+    double bandwidth() const;
+    uint64_t wire_size(uint64_t payload) const;
+    uint64_t read_requests_size(uint64_t payload) const;
+    double transfer_time(uint64_t payload) const;
+    double first_packet_time(uint64_t payload) const;
+
+    static const BxiPciModel* get(const std::string& spec);
+};
+
+#endif // S4BXI_BXIPCIMODEL_HPP
@@ -0,0 +1,45 @@
+/*
+ * Author: Julien EMMANUEL
+ * Copyright (C) 2019-2022 Bull S.A.S
+ * All rights reserved
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation,
+ * which comes with this package.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#ifndef S4BXI_BXIPOOL_HPP
+#define S4BXI_BXIPOOL_HPP
+
+#include <cstddef>
+
+/**
+ * @brief Free-list allocator for messages and requests
+ *
+ * Several BxiMsg and BxiRequest are created and destroyed for each simulated
+ * operation, so instead of going through malloc each time, freed objects are
+ * kept in one free-list per size class (there is one class per 16 bytes, so in
+ * practice each concrete message / request type ends up in its own class) and
+ * reused by the next allocation of the same size. Memory is grabbed from the
+ * system by chunks and is never given back before the end of the process.
+ *
+ * Everything runs in SimGrid's maestro thread, so there is no locking at all.
+ *
+ * Compiling with -DNO_POOL_ALLOCATOR=ON makes it a thin wrapper around the
+ * global operator new / delete, which is what you want when running with
+ * AddressSanitizer or Valgrind
+ */
+class BxiPool {
+  public:
+    static void* allocate(size_t size);
+    static void release(void* p, size_t size);
+    static void log_stats();
+};
+
+#endif // S4BXI_BXIPOOL_HPP
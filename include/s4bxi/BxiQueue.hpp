@@ -40,7 +40,7 @@ class BxiQueue {
 
   public:
     BxiQueue();
-    explicit BxiQueue(const std::string& mailbox_name);
+    explicit BxiQueue(simgrid::s4u::Mailbox* mailbox);
 
     void put(BxiMsg* msg, const uint64_t& size = 0, bool async = false);
     BxiMsg* get();
@@ -0,0 +1,81 @@
+/*
+ * Author: Julien EMMANUEL
+ * Copyright (C) 2019-2022 Bull S.A.S
+ * All rights reserved
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation,
+ * which comes with this package.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#ifndef S4BXI_BXISTATS_HPP
+#define S4BXI_BXISTATS_HPP
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "s4ptl.hpp" // Must come before BxiLog.hpp
+#include "BxiLog.hpp"
+
+#define S4BXI_HISTOGRAM_SUB_BUCKETS 4  // Per power of two
+#define S4BXI_HISTOGRAM_OCTAVES     48 // From 1 ns to ~1.6 days
+
+/**
+ * @brief Streaming histogram with logarithmic buckets
+ *
+ * Each power of two is split in S4BXI_HISTOGRAM_SUB_BUCKETS buckets, so values
+ * are known with a relative precision of 1 / S4BXI_HISTOGRAM_SUB_BUCKETS.
+ * Values are in nanoseconds, anything under 1 ns ends up in the first bucket
+ */
+class BxiHistogram {
+  public:
+    static constexpr int BUCKETS = S4BXI_HISTOGRAM_SUB_BUCKETS * S4BXI_HISTOGRAM_OCTAVES;
+
+    unsigned long count = 0;
+    double sum          = 0;
+    double min          = 0;
+    double max          = 0;
+    std::array<unsigned long, BUCKETS> buckets{};
+
+    void add(double value);
+    static double bucket_lower_bound(int bucket);
+};
+
+/**
+ * @brief Aggregated version of the logs, enabled by S4BXI_STATS
+ *
+ * Instead of keeping each BxiLog, we keep a latency histogram per log type, and
+ * counters per (node, log type) and per (initiator, target) pair, so that the
+ * memory footprint only depends on the size of the platform, not on the length
+ * of the simulation. Everything is dumped as JSON at the end of the simulation
+ */
+class BxiStats {
+    struct type_counters {
+        unsigned long count = 0;
+        unsigned long bytes = 0;
+        double busy_time    = 0;
+    };
+    struct pair_counters {
+        unsigned long messages = 0;
+        unsigned long bytes    = 0;
+    };
+
+    std::array<BxiHistogram, S4BXILOG_TYPE_COUNT> latencies;
+    std::vector<std::array<type_counters, S4BXILOG_TYPE_COUNT>> nodes; // Indexed by NID
+    std::unordered_map<uint64_t, pair_counters> pairs;                 // Key is (initiator << 32 | target)
+
+  public:
+    void record(const BxiLog& log);
+    void dump(const std::string& path, const std::string& simulation_id, double simulated_time) const;
+};
+
+#endif // S4BXI_BXISTATS_HPP
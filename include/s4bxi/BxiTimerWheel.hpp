@@ -0,0 +1,71 @@
+/*
+ * Author: Julien EMMANUEL
+ * Copyright (C) 2019-2022 Bull S.A.S
+ * All rights reserved
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation,
+ * which comes with this package.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+
+#ifndef S4BXI_BXITIMERWHEEL_HPP
+#define S4BXI_BXITIMERWHEEL_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "s4ptl.hpp"
+
+/**
+ * @brief Hierarchical timer wheel holding the messages that wait for their E2E timeout
+ *
+ * Deadlines are integer ticks. Level `l` has 64 slots of 64^l ticks each, and a
+ * message is stored at the level of the highest base-64 digit in which its
+ * deadline differs from the current tick, so that inserting and removing are
+ * O(1). When time reaches the start of a slot of a higher level, its messages
+ * are cascaded down to the lower levels, and when it reaches a slot of level 0
+ * they are expired all at once. Each level has a bitmap of its non-empty slots
+ * to find the next expiry quickly.
+ *
+ * Messages are chained in their slot through their `e2e_prev` / `e2e_next`
+ * pointers, in insertion order
+ */
+class BxiTimerWheel {
+  public:
+    static constexpr int LEVEL_BITS = 6;
+    static constexpr int SLOTS      = 1 << LEVEL_BITS;
+    static constexpr int LEVELS     = 8; // Up to 2^48 ticks ahead
+
+  private:
+    struct Chain {
+        BxiMsg* head = nullptr;
+        BxiMsg* tail = nullptr;
+    };
+
+    Chain slots[LEVELS][SLOTS];
+    uint64_t occupied[LEVELS] = {};
+    uint64_t current          = 0;
+    size_t count              = 0;
+
+    void link(BxiMsg* msg);
+    void unlink(BxiMsg* msg);
+    int next_level(uint64_t* when) const;
+
+  public:
+    void insert(BxiMsg* msg, uint64_t deadline);
+    bool remove(BxiMsg* msg);
+    uint64_t next_expiry() const;
+    void advance(uint64_t now, std::vector<BxiMsg*>& expired);
+    bool empty() const { return !count; }
+    size_t size() const { return count; }
+    void clear();
+};
+
+#endif // S4BXI_BXITIMERWHEEL_HPP
@@ -0,0 +1,108 @@
+/*
+ * Author: Julien EMMANUEL
+ * Copyright (C) 2019-2022 Bull S.A.S
+ * All rights reserved
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation,
+ * which comes with this package.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#ifndef S4BXI_BXITRACE_HPP
+#define S4BXI_BXITRACE_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "s4ptl.hpp" // Must come before BxiLog.hpp
+#include "BxiLog.hpp"
+
+#define S4BXI_TRACE_MAGIC   "S4BXITR"
+#define S4BXI_TRACE_VERSION 1
+
+/**
+ * @brief Header at the beginning of each binary trace
+ */
+struct bxi_trace_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    char simulation_id[16];
+};
+
+/**
+ * @brief Fixed-size on-disk version of a BxiLog
+ */
+struct bxi_trace_record {
+    double start;
+    double end;
+    uint32_t type;
+    uint32_t initiator;
+    uint32_t target;
+    uint32_t padding;
+};
+
+/**
+ * @brief Binary sink for BxiLogs
+ *
+ * Records are appended to a large in-memory buffer, which is written to the
+ * file in one go when it's full, so that logging an event is only a copy of a
+ * few bytes. If `async` is set the writes happen in a background thread, while
+ * the simulation keeps filling a second buffer.
+ *
+ * Traces can be turned back into the CSV logs of previous versions using
+ * `s4bxi-trace2csv`
+ */
+class BxiTrace {
+    FILE* file;
+    std::vector<bxi_trace_record> buffer;
+    size_t used = 0;
+
+    bool async;
+    std::thread writer;
+    std::mutex writer_mutex;
+    std::condition_variable writer_cv;
+    std::vector<bxi_trace_record> pending; // Full buffer handed to the writer thread
+    size_t pending_used = 0;
+    bool closing        = false;
+    std::atomic<bool> failed{false};
+
+    void flush();
+    void write_records(const bxi_trace_record* records, size_t count);
+    void writer_loop();
+
+  public:
+    BxiTrace(const std::string& path, const std::string& simulation_id, bool async);
+    ~BxiTrace();
+
+    void append(const BxiLog& log)
+    {
+        auto& r     = buffer[used];
+        r.start     = log.start;
+        r.end       = log.end;
+        r.type      = log.type;
+        r.initiator = log.initiator;
+        r.target    = log.target;
+        r.padding   = 0;
+
+        if (++used == buffer.size())
+            flush();
+    }
+    void close();
+
+    static bool read_header(FILE* f, bxi_trace_header* header);
+};
+
+#endif // S4BXI_BXITRACE_HPP
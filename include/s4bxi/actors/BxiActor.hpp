@@ -37,17 +37,16 @@ class BxiActor {
     std::shared_ptr<BxiNode> node;
     simgrid::s4u::Actor* self;
 
-    // Mailbox names
-    std::string nic_rx_mailbox_name(const bxi_vn);
-    std::string nic_tx_mailbox_name(const bxi_vn);
-    static std::string nic_rx_mailbox_name(const int, const bxi_vn);
-    static std::string nic_tx_mailbox_name(const int, const bxi_vn);
-
     // Events
-    void issue_event(BxiEQ* eq, ptl_event_t* ev);
+    void issue_event(BxiEQ* eq, const ptl_event_t* ev);
 
   public:
     BxiActor();
+    static int nid_from_slug(const std::string& slug);
+    // Mailbox names
+    static std::string nic_rx_mailbox_name(const int, const bxi_vn);
+    static std::string nic_tx_mailbox_name(const int, const bxi_vn);
+
     simgrid::s4u::Actor* getSimgridActor();
     ptl_nid_t getNid();
     std::string getSlug();
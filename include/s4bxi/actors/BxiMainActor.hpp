@@ -42,10 +42,12 @@ class BxiMainActor : public BxiActor {
     std::shared_ptr<BxiQueue> tx_queue;
     unsigned int poll_count = 0;
     uint8_t is_sampling;
+    std::shared_ptr<BxiWaiter> waiter; // Shared by all the blocking waits on CTs and EQs of this actor
 
     void issue_portals_command(int simulated_size);
     void issue_portals_command();
     bool is_PIO(BxiMsg* msg);
+    const std::shared_ptr<BxiWaiter>& get_waiter();
 
   public:
     // Amaury says there's no need to initialise with nullptrs,
@@ -65,6 +67,9 @@ class BxiMainActor : public BxiActor {
      */
     BxiNI* default_ni;
     double cpu_accumulator = 0;
+    // COMPUTE record of the current benchmarked block, decided in s4bxi_bench_begin so that begin and end agree
+    BxiLog bench_log;
+    bool bench_must_log = false;
 
     std::map<char*, void*, cmp_str> keyval_store;
 
@@ -108,12 +113,10 @@ class BxiMainActor : public BxiActor {
     //
     int PtlLEAppend(ptl_handle_ni_t, ptl_index_t, const ptl_le_t*, ptl_list_t, void*, ptl_handle_le_t*);
     int PtlLEUnlink(ptl_handle_le_t);
-    // int PtlLESearch(ptl_handle_ni_t, ptl_pt_index_t, const ptl_le_t *,
-    //                ptl_search_op_t, void *);
+    int PtlLESearch(ptl_handle_ni_t, ptl_pt_index_t, const ptl_le_t*, ptl_search_op_t, void*);
     int PtlMEAppend(ptl_handle_ni_t, ptl_index_t, const ptl_me_t*, ptl_list_t, void*, ptl_handle_me_t*);
     int PtlMEUnlink(ptl_handle_me_t);
-    // int PtlMESearch(ptl_handle_ni_t, ptl_pt_index_t, const ptl_me_t *,
-    //                ptl_search_op_t, void *);
+    int PtlMESearch(ptl_handle_ni_t, ptl_pt_index_t, const ptl_me_t*, ptl_search_op_t, void*);
     //
     int PtlEQAlloc(ptl_handle_ni_t, ptl_size_t, ptl_handle_eq_t*);
     // int PtlEQAllocAsync(ptl_handle_ni_t, ptl_size_t, ptl_handle_eq_t *,
@@ -191,14 +194,18 @@ class BxiMainActor : public BxiActor {
     {
         return PtlLEAppend(n, i, le, li, v, h);
     }
-    // int PtlLESearchNB(ptl_handle_ni_t, ptl_pt_index_t, const ptl_le_t *,
-    //                  ptl_search_op_t, void *);
+    int PtlLESearchNB(ptl_handle_ni_t n, ptl_pt_index_t p, const ptl_le_t* le, ptl_search_op_t o, void* v)
+    {
+        return PtlLESearch(n, p, le, o, v);
+    }
     int PtlMEAppendNB(ptl_handle_ni_t n, ptl_index_t i, const ptl_me_t* m, ptl_list_t l, void* v, ptl_handle_me_t* h)
     {
         return PtlMEAppend(n, i, m, l, v, h);
     }
-    // int PtlMESearchNB(ptl_handle_ni_t, ptl_pt_index_t, const ptl_me_t *,
-    //                  ptl_search_op_t, void *);
+    int PtlMESearchNB(ptl_handle_ni_t n, ptl_pt_index_t p, const ptl_me_t* me, ptl_search_op_t o, void* v)
+    {
+        return PtlMESearch(n, p, me, o, v);
+    }
     //
     int PtlMDBindNB(ptl_handle_ni_t n, const ptl_md_t* m, ptl_handle_md_t* h) { return PtlMDBind(n, m, h); }
 
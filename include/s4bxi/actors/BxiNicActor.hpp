@@ -21,19 +21,21 @@
 #include <string>
 
 #include "BxiActor.hpp"
+#include "BxiNicPolicy.hpp"
 #include "../s4ptl.hpp"
 
-constexpr double PCI_LATENCY = 200e-9; // Hardcoding this is awful, but also it's not going to be vastly different on different platforms
-constexpr double ONE_PCI_PACKET_TRANSFER = PCI_LATENCY + 32.508e-9 /* Bandwidth for 512B */;
+// Time the NIC spends processing a request, on top of the PCI latency (see BxiPciModel)
+constexpr double NIC_GET_PROCESSING      = 50e-9;
+constexpr double NIC_RESPONSE_PROCESSING = 100e-9;
 
 class BxiNicActor : public BxiActor {
   protected:
     bxi_vn vn;
     void maybe_issue_get(BxiGetRequest* req);
     void maybe_issue_fetch_atomic(BxiFetchAtomicRequest* req);
-    void reliable_comm(BxiMsg* msg);
-    void shallow_reliable_comm(BxiMsg* msg);
-    simgrid::s4u::CommPtr reliable_comm_init(BxiMsg* msg, bool shallow);
+    template <typename Policy> void reliable_comm(BxiMsg* msg);
+    template <typename Policy> void shallow_reliable_comm(BxiMsg* msg);
+    template <typename Policy> simgrid::s4u::CommPtr reliable_comm_init(BxiMsg* msg, bool shallow);
 
   public:
     BxiNicActor(const std::vector<std::string>& args);
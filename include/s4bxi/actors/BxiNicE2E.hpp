@@ -17,21 +17,27 @@
 #ifndef S4BXI_BXINICE2E_HPP
 #define S4BXI_BXINICE2E_HPP
 
+#include <vector>
+
 #include "BxiActor.hpp"
 #include "../s4ptl.hpp"
-#include "../BxiQueue.hpp"
+#include "../BxiTimerWheel.hpp"
 
 class BxiNicE2E : public BxiActor {
-    simgrid::s4u::Mailbox* nic_cmd_mailboxes[4] = {nullptr};
-    BxiMsg* current_msg                         = nullptr;
-    BxiQueue queue;
+    BxiTimerWheel wheel;
+    std::vector<BxiMsg*> expired;
+    simgrid::s4u::SemaphorePtr wakeup;
+    double tick;           // Duration of a tick of the wheel, in seconds
+    double planned_wakeup; // When the actor will look at the wheel again (infinity if it's empty)
+
+    void handle_timeout(BxiMsg* msg);
 
   public:
     explicit BxiNicE2E(const std::vector<std::string>& args);
 
     void operator()();
-    simgrid::s4u::Mailbox* get_retransmit_mailbox(const BxiMsg* msg);
     void process_message(BxiMsg* msg);
+    void cancel(BxiMsg* msg);
 };
 
 #endif // S4BXI_BXINICE2E_HPP
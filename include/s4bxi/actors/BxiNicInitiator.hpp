@@ -25,8 +25,10 @@
  *
  * This actor listens for commands from the PCI bus and processes
  * them to send the correct message on the BXI network
+ *
+ * @tparam Policy Features compiled in the pipeline (see BxiNicPolicy)
  */
-class BxiNicInitiator : public BxiNicActor {
+template <typename Policy> class BxiNicInitiator : public BxiNicActor {
     std::shared_ptr<BxiQueue> tx_queue;
 
     void handle_put(BxiMsg* msg);
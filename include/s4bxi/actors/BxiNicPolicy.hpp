@@ -0,0 +1,55 @@
+/*
+ * Author: Julien EMMANUEL
+ * Copyright (C) 2019-2022 Bull S.A.S
+ * All rights reserved
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation,
+ * which comes with this package.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#ifndef S4BXI_BXINICPOLICY_HPP
+#define S4BXI_BXINICPOLICY_HPP
+
+#include "../s4bxi_config.hpp"
+
+/**
+ * @brief Features that the NIC actors are compiled with
+ *
+ * A feature that is disabled in the policy is never simulated, which lets the compiler
+ * strip the corresponding branches from the NIC pipelines. A feature that is enabled is
+ * still subject to the runtime configuration (global and per-node)
+ */
+template <bool PCI, bool E2E, bool LOG, bool REAL_MEMORY> struct BxiNicPolicy {
+    static constexpr bool model_pci          = PCI;
+    static constexpr bool model_pci_commands = PCI;
+    static constexpr bool e2e                = E2E;
+    static constexpr bool log                = LOG;
+    static constexpr bool use_real_memory    = REAL_MEMORY;
+
+    /**
+     * @return Whether this policy compiles in everything that the configuration could enable
+     */
+    static bool supports(const s4bxi_config& config)
+    {
+        return (model_pci || !config.model_pci) && (e2e || config.e2e_off) && (log || !config.log_level) &&
+               (use_real_memory || !config.use_real_memory);
+    }
+};
+
+// Everything is decided at runtime
+typedef BxiNicPolicy<true, true, true, true> BxiFullNicPolicy;
+// No PCI, no E2E, no logs and fake memory, which is what parameter sweeps usually run with
+typedef BxiNicPolicy<false, false, false, false> BxiFastNicPolicy;
+
+#define S4BXI_POLICY_AND(policy, node, name) (policy::name && S4BXI_CONFIG_AND(node, name))
+#define S4BXI_POLICY_E2E_ON(policy, node)    (policy::e2e && !S4BXI_CONFIG_OR(node, e2e_off))
+#define S4BXI_POLICY_LOG_LEVEL(policy)       (policy::log ? S4BXI_GLOBAL_CONFIG(log_level) : 0)
+
+#endif // S4BXI_BXINICPOLICY_HPP
@@ -23,16 +23,24 @@
 #include "BxiNicActor.hpp"
 #include "../s4ptl.hpp"
 #include "../BxiQueue.hpp"
+#include "../BxiAckQueue.hpp"
 
 /**
  * @brief RX side of the NIC
  *
  * This actor listens for messages from the BXI network and processes
  * them to issue the correct event and/or send a response
+ *
+ * When ACKs are modeled analytically, each target of a response VN spawns a
+ * twin which doesn't listen to the network, but processes the ACKs that were
+ * put in the BxiAckQueue of its VN instead
+ *
+ * @tparam Policy Features compiled in the pipeline (see BxiNicPolicy)
  */
-class BxiNicTarget : public BxiNicActor {
+template <typename Policy> class BxiNicTarget : public BxiNicActor {
     simgrid::s4u::Mailbox* nic_rx_mailbox;
     std::shared_ptr<BxiQueue> tx_queue;
+    std::shared_ptr<BxiAckQueue> ack_queue; // Only for the twin that delivers analytic ACKs
 
     void handle_put_request(BxiMsg* msg);
     void handle_get_request(BxiMsg* msg);
@@ -48,10 +56,13 @@ class BxiNicTarget : public BxiNicActor {
                          size_t len);
     void capped_memcpy(void* dest, const void* src, size_t n);
     void send_ack(BxiMsg* msg, bxi_msg_type ack_type, int ni_fail_type);
+    void put_ack(BxiMsg* ack);
+    bool send_analytic_ack(BxiMsg* ack);
     bool put_like_req_ev_processing(BxiME* me, BxiMsg* msg, ptl_event_kind ev_kind);
+    void cancel_e2e(BxiMsg* msg);
 
   public:
-    BxiNicTarget(const std::vector<std::string>& args);
+    explicit BxiNicTarget(const std::vector<std::string>& args, bool delivers_analytic_acks = false);
 
     void operator()();
 };
@@ -20,9 +20,12 @@
 /**
  * @brief Global configuration of the simulation
  *
- * Most of these values are hydrated at startup based on environment variables
+ * Most of these values are hydrated at startup based on environment variables. There is a
+ * single instance, owned by BxiEngine, which is read-only once the engine is initialized
+ * (except for the log level, see BxiEngine::set_log_level). It is aligned on a cache line
+ * because the NIC actors read it on every message
  */
-struct s4bxi_config {
+struct alignas(64) s4bxi_config {
     /** @brief Maximum number of E2E retries before giving up */
     int max_retries;
     /** @brief E2E timeout between retries */
@@ -33,14 +36,28 @@ struct s4bxi_config {
     bool model_pci;
     /** @brief Model small PCI transfers when issuing commands to the NIC */
     bool model_pci_commands;
+    /** @brief Default model of the PCIe links (preset and optional overrides, e.g. "gen4x16:mps=512") */
+    std::string pci_model;
+    /** @brief Compute the duration of PCI transfers that don't compete with any other instead of simulating them */
+    bool analytic_pci;
     /** @brief Disable all E2E processing globally */
     bool e2e_off;
     /** @brief Output folder for CSV logging */
     std::string log_folder;
     /** @brief Log computational phases, which can generate huge logs */
     bool log_computation;
-    /** @brief Set to 0 to diable logging (computed based on log_folder) */
+    /** @brief Only log events involving these NIDs (e.g. "0-15,42", empty for all) */
+    std::string log_nids;
+    /** @brief Only log these event types (e.g. "PTL_PUT,PCI_DMA_PAYLOAD", empty for all) */
+    std::string log_types;
+    /** @brief Only log events starting in this window of simulated time (e.g. "1e-3:2e-3", empty for all) */
+    std::string log_window;
+    /** @brief Output file for aggregated statistics (empty to disable them) */
+    std::string stats_file;
+    /** @brief Set to 0 to diable logging (computed based on log_folder and stats_file) */
     int log_level;
+    /** @brief Write the binary trace from a background thread */
+    bool log_async;
     /** @brief Shared libraries to privatize and re-link to user code at runtime */
     std::string privatize_libs;
     /** @brief Disable deleting temporary libraries created by S4BXI */
@@ -55,8 +72,16 @@ struct s4bxi_config {
     double active_polling_delay;
     /** @brief Accumulate small CPU operations instead of ignoring them */
     double cpu_accumulate;
+    /** @brief Model of lost messages (e.g. "uniform:1e-4" or "gilbert:P_GB,P_BG,LOSS_GOOD,LOSS_BAD", empty for none) */
+    std::string loss_model;
+    /** @brief Seed of the random generators of the loss model */
+    unsigned long loss_seed;
+    /** @brief Windows during which links lose every message (e.g. "0-3>4@1e-3:2e-3;5>*@0.5:") */
+    std::string link_faults;
     /** @brief Triggers ACK at sender side without issuing an actual ACK message on the network */
     bool quick_acks;
+    /** @brief Compute the latency of ACKs on uncongested paths instead of sending them on the network */
+    bool analytic_acks;
     /** @brief Shared memory threshold */
     double auto_shared_malloc_thresh;
     /** @brief Type of shared malloc (global, local or none) */
@@ -73,6 +98,8 @@ struct s4bxi_config {
     bool no_dlclose;
     /** @brief Use PugiXML instead of SimGrid's parser for deployments */
     bool use_pugixml;
+    /** @brief Index matching entries of PTs by match bits instead of walking the lists linearly */
+    bool indexed_matching;
 };
 
 #endif // S4BXI_s4bxi_config_HPP
@@ -36,16 +36,19 @@
 
 #define HAS_PTL_OPTION(ptl_object, flag) (((ptl_object)->options & (flag)) != 0)
 
-#define S4BXI_GLOBAL_CONFIG(name)    (BxiEngine::get_config()->name)
+#define S4BXI_GLOBAL_CONFIG(name)    (BxiEngine::get_config().name)
 #define S4BXI_CONFIG_AND(node, name) (node->name && S4BXI_GLOBAL_CONFIG(name))
 #define S4BXI_CONFIG_OR(node, name)  (node->name || S4BXI_GLOBAL_CONFIG(name))
 
 // int __bxi_log_level = S4BXI_GLOBAL_CONFIG(log_level) && (log_type == S4BXILOG_PTL_PUT || log_type ==
 // S4BXILOG_PTL_GET_RESPONSE)
-#define S4BXI_STARTLOG(log_type, log_initiator, log_target)                                                            \
+#define S4BXI_STARTLOG(log_type, log_initiator, log_target) S4BXI_STARTLOG_IF(true, log_type, log_initiator, log_target)
+
+// Same as S4BXI_STARTLOG, but compiled out when `enabled` is a constant false
+#define S4BXI_STARTLOG_IF(enabled, log_type, log_initiator, log_target)                                                \
     BxiLog __bxi_log;                                                                                                  \
-    int __bxi_log_level = S4BXI_GLOBAL_CONFIG(log_level);                                                              \
-    bool __bxi_must_log = __bxi_log_level && (log_type != S4BXILOG_COMPUTE || S4BXI_GLOBAL_CONFIG(log_computation));   \
+    int __bxi_log_level = (enabled) ? S4BXI_GLOBAL_CONFIG(log_level) : 0;                                              \
+    bool __bxi_must_log = __bxi_log_level && BxiEngine::must_log(log_type, log_initiator, log_target);                 \
     if (__bxi_must_log) {                                                                                              \
         __bxi_log.start     = simgrid::s4u::Engine::get_clock();                                                       \
         __bxi_log.type      = log_type;                                                                                \
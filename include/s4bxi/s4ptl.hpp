@@ -20,6 +20,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <utility>
 #include <simgrid/s4u.hpp>
 #include <memory>
@@ -27,6 +28,7 @@
 
 #include "portals4.h"
 #include "s4bxi/BxiLog.hpp"
+#include "s4bxi/BxiPool.hpp"
 
 // Early declaration in order not to break every single include
 class BxiNode;
@@ -35,6 +37,8 @@ class BxiNode;
 #define EVENT_SIZE   96 // Currently equal to `sizeof(ptl_event_t)`
 #define COMMAND_SIZE 64
 
+#define PT_INDEXES_COUNT 256 // max_pt_index is capped at 255 in NI limits
+
 enum bxi_msg_type {
     S4BXI_E2E_ACK,
     S4BXI_PTL_ACK,
@@ -67,11 +71,30 @@ enum bxi_vn {
     S4BXI_VN_COMPUTE_RESPONSE,
 };
 
+/**
+ * @brief What an actor uses to wait on CTs and EQs (there is one per actor, see BxiMainActor)
+ *
+ * Each PtlCTWait / PtlCTPoll registers entries tagged with the current generation in
+ * the CTs it waits on. Bumping the generation once the wait is over invalidates all
+ * of them at once, and the CTs discard them lazily. EQs simply keep the waiters that
+ * are blocked on them, which remove themselves when they are done
+ */
+class BxiWaiter {
+  public:
+    simgrid::s4u::MutexPtr mutex;
+    simgrid::s4u::ConditionVariablePtr cv;
+    uint64_t generation = 0;
+
+    BxiWaiter();
+};
+
 class ActorWaitingCT {
   public:
-    simgrid::s4u::Actor* actor;
-    simgrid::s4u::Mailbox* mailbox;
     ptl_size_t test;
+    uint64_t generation;
+    std::shared_ptr<BxiWaiter> waiter;
+
+    bool is_stale() const { return generation != waiter->generation; }
 };
 
 // All the following /Bxi([A-Z]+)/ structs are the actual types
@@ -86,18 +109,102 @@ class BxiME;
 class BxiRequest;
 class BxiMsg;
 
-typedef std::vector<BxiME*> BxiList;
-// typedef shared_ptr<BxiList> BxiListPtr;
+/**
+ * @brief Priority or overflow list of a PT, linked through the `list_prev` / `list_next` pointers of the MEs
+ */
+class BxiList {
+  public:
+    BxiME* head  = nullptr;
+    BxiME* tail  = nullptr;
+    size_t count = 0;
+
+    void push_back(BxiME* me);
+    void erase(BxiME* me);
+    bool empty() const { return !count; }
+    size_t size() const { return count; }
+};
+
+/**
+ * @brief Chain of MEs, linked through their `idx_prev` / `idx_next` pointers
+ */
+class BxiMEChain {
+  public:
+    BxiME* head = nullptr;
+    BxiME* tail = nullptr;
+
+    void push_back(BxiME* me);
+    void erase(BxiME* me);
+};
+
+/**
+ * @brief Match bits index of one of the lists (priority or overflow) of a PT
+ *
+ * Entries that don't ignore any bit are hashed on their match bits, the other
+ * ones (wildcards) are kept in insertion order in a side chain. Each entry gets
+ * a sequence number when it's appended to the PT, which is what allows us to
+ * respect the first-match rule of Portals when both an exact entry and a
+ * wildcard match the same request
+ */
+class BxiMatchIndex {
+    std::unordered_map<ptl_match_bits_t, BxiMEChain> exact;
+    BxiMEChain wildcards;
+
+  public:
+    void insert(BxiME* me);
+    void remove(BxiME* me);
+    BxiME* find(BxiRequest* req);
+    void clear();
+};
+
+/**
+ * @brief Unexpected headers of a PT
+ *
+ * Headers are chained in arrival order through their `uh_prev` / `uh_next`
+ * pointers, and (if the store is indexed) in per-match-bits chains through
+ * `uh_bucket_prev` / `uh_bucket_next`, so that both lookups by exact MEs and
+ * removals are cheap
+ */
+class BxiUHStore {
+    struct Chain {
+        BxiMsg* head = nullptr;
+        BxiMsg* tail = nullptr;
+    };
+
+    Chain arrival;
+    std::unordered_map<ptl_match_bits_t, Chain> buckets;
+    size_t count = 0;
+
+    bool uses_index(const BxiME* me) const;
+
+  public:
+    bool indexed = false;
+
+    void push_back(BxiMsg* msg);
+    void erase(BxiMsg* msg);
+    BxiMsg* first_match(BxiME* me) const;
+    BxiMsg* next_match(BxiME* me, const BxiMsg* msg) const;
+    BxiMsg* front() const { return arrival.head; }
+    bool empty() const { return !count; }
+    size_t size() const { return count; }
+    void clear();
+};
 
 class BxiPT {
+    BxiMatchIndex priority_index;
+    BxiMatchIndex overflow_index;
+    uint64_t next_seq = 0;
+
+    BxiME* find_entry(ptl_list_t list, BxiRequest* req);
+
   public:
-    std::shared_ptr<BxiList> priority_list;  // Stores both ME and LE
-    std::shared_ptr<BxiList> overflow_list;  // Same
-    std::vector<BxiMsg*> unexpected_headers; // On the NIC UH are a type of ME, but for us I think a BxiMsg is easier
+    BxiList priority_list; // Stores both ME and LE
+    BxiList overflow_list; // Same
+    BxiUHStore unexpected_headers; // On the NIC UH are a type of ME, but for us I think a BxiMsg is easier
     BxiEQ* eq;
     BxiNI* ni;
     unsigned int options;
     bool enabled = true;
+    bool indexed;
     ptl_index_t index;
 
     BxiPT(ptl_handle_ni_t ni_handle, ptl_handle_eq_t eq_handle, ptl_index_t index, unsigned int options);
@@ -109,8 +216,11 @@ class BxiPT {
 
     int enable();
     int disable();
+    void insert(BxiME* me);
+    void remove(BxiME* me);
     BxiME* walk_through_lists(BxiMsg* msg);
     bool walk_through_UHs(BxiME* me);
+    void search(const ptl_me_t* me_t, ptl_search_op_t op, void* user_ptr);
 };
 
 class BxiNI {
@@ -121,7 +231,8 @@ class BxiNI {
     ptl_ni_limits* limits;
     ptl_pid_t pid;
     simgrid::s4u::SemaphorePtr cq;
-    std::map<ptl_pt_index_t, BxiPT*> pt_indexes;
+    BxiPT* pt_indexes[PT_INDEXES_COUNT]             = {}; // nullptr for indexes that are not allocated
+    uint64_t used_pt_indexes[PT_INDEXES_COUNT / 64] = {}; // Same thing as a bitmap, to find free indexes quickly
     std::vector<ptl_process_t> l2p_map;
 
     BxiNI(std::shared_ptr<BxiNode> node, ptl_interface_t iface, unsigned int options, ptl_pid_t pid,
@@ -131,47 +242,82 @@ class BxiNI {
                        const ptl_ni_limits_t* desired, ptl_ni_limits_t* actual);
     static void fini(ptl_handle_ni_t handle);
     bool can_match_request(BxiRequest* req);
+    ptl_pt_index_t first_free_pt_index() const;
     ptl_rank_t get_l2p_rank();
     const ptl_process_t get_physical_proc(const ptl_process_t& proc);
 };
 
 class BxiCT {
+    std::vector<ActorWaitingCT> waiting; // Min-heap on the threshold
+    size_t compaction_size = 64;
+
+    void add_waiter(ptl_size_t test, const std::shared_ptr<BxiWaiter>& waiter);
+
   public:
     void on_update();
-    std::vector<ActorWaitingCT> waiting;
     ptl_ct_event_t event;
 
     BxiCT();
+    bool reached(ptl_size_t test) const { return event.success >= test || event.failure; }
     int increment(ptl_ct_event_t);
     int set_value(ptl_ct_event_t);
     void increment_success(ptl_size_t);
-    int wait(ptl_size_t test, ptl_ct_event_t* ev);
+    int wait(ptl_size_t test, ptl_ct_event_t* ev, const std::shared_ptr<BxiWaiter>& waiter);
 
     static int poll(const ptl_handle_ct_t* ct_handles, const ptl_size_t* tests, unsigned int size, ptl_time_t timeout,
-                    ptl_ct_event_t* event, unsigned int* which);
+                    ptl_ct_event_t* event, unsigned int* which, const std::shared_ptr<BxiWaiter>& waiter);
 };
 
+/**
+ * @brief Event queue, stored as a fixed-capacity ring buffer
+ *
+ * The capacity is the `count` given to PtlEQAlloc. When the queue is full new events
+ * are dropped, and the first event that gets in after them is read with PTL_EQ_DROPPED
+ * instead of PTL_OK (sec 3.13 in spec). Actors blocked in PtlEQWait / PtlEQPoll register a
+ * condition variable in `waiters`, which is notified each time an event is pushed
+ */
 class BxiEQ {
+    std::vector<ptl_event_t> events;
+    std::vector<bool> follows_drop;
+    size_t head  = 0; // Oldest event
+    size_t count = 0;
+    bool dropped = false;
+
+    int pop(ptl_event_t* event);
+
   public:
-    simgrid::s4u::Mailbox* mailbox;
+    std::vector<std::shared_ptr<BxiWaiter>> waiters;
+    unsigned long dropped_count = 0;
 
-    BxiEQ();
-    ~BxiEQ();
+    explicit BxiEQ(ptl_size_t capacity);
+    void push(const ptl_event_t* event);
+    bool empty() const { return !count; }
     int get(ptl_event_t* event);
-    int wait(ptl_event_t* event);
+    int wait(ptl_event_t* event, const std::shared_ptr<BxiWaiter>& waiter);
 
     static int poll(const ptl_handle_eq_t* eq_handles, unsigned int size, ptl_time_t timeout, ptl_event_t* event,
-                    unsigned int* which);
+                    unsigned int* which, const std::shared_ptr<BxiWaiter>& waiter);
 };
 
+/**
+ * MDs are shared by the user's handle and the requests that use them, so they are
+ * refcounted: PtlMDRelease only drops the user's reference (or returns PTL_IN_USE if
+ * some requests will still issue events on it), and the MD is actually destroyed once
+ * the last request referencing it is deleted
+ */
 class BxiMD {
   public:
     BxiNI* ni;
     ptl_md_t md;
+    unsigned int ref_count   = 1; // The user's handle
+    unsigned int pending_ops = 0; // Requests that will still issue events on this MD
 
     BxiMD(ptl_handle_ni_t ni_handle, const ptl_md_t* md_t);
     BxiMD(const BxiMD& md);
     void increment_ct(ptl_size_t byte_count);
+
+    static int release(BxiMD* md);
+    static void unref(BxiMD* md);
 };
 
 class BxiME {
@@ -184,14 +330,19 @@ class BxiME {
     ptl_list_t list;
     bool needs_unlink = false;
     bool in_use = false;
+    uint64_t seq = 0; // Order of insertion in the PT, to keep first-match semantics when using the index
+    BxiME* idx_prev  = nullptr;
+    BxiME* idx_next  = nullptr;
+    BxiME* list_prev = nullptr;
+    BxiME* list_next = nullptr;
 
     BxiME(BxiPT* pt, const ptl_me_t* me_t, ptl_list_t list, void* user_ptr);
     BxiME(const BxiME& me);
     void increment_ct(ptl_size_t byte_count);
     bool matches_request(BxiRequest* req);
     ptl_addr_t get_offsetted_addr(BxiMsg* msg, bool update_manage_local_offset = false);
-    std::shared_ptr<BxiList> get_list();
-    std::shared_ptr<BxiList> get_list(BxiPT* pt);
+    BxiList* get_list();
+    BxiList* get_list(BxiPT* pt);
     ptl_size_t get_mlength(const BxiRequest* req);
 
     static void append(BxiPT* pt, const ptl_me_t* me_t, ptl_list_t list, void* user_ptr, ptl_handle_me_t* me_handle);
@@ -214,7 +365,7 @@ class BxiRequest {
     ptl_size_t mlength;
     bxi_req_type type;
     uint64_t payload_size; // In bytes
-    std::shared_ptr<BxiMD> md;
+    BxiMD* md;
     bool matching;
     ptl_match_bits_t match_bits;
     ptl_pid_t target_pid;
@@ -229,10 +380,18 @@ class BxiRequest {
     ptl_addr_t start; // "start" as in a ptl_event_t, it's easier to store it in the request than to re-compute it when
                       // issuing events, so there it is
     std::unique_ptr<BxiME> matched_me = nullptr; // Unused for PUT and ATOMIC on priority list
+    bool md_in_use                    = true;    // Counted in the `pending_ops` of its MD(s)
 
     BxiRequest(bxi_req_type type, BxiMD* md, ptl_size_t payload_size, bool matching, ptl_match_bits_t match_bits,
                ptl_pid_t target_pid, ptl_pt_index_t pt_index, void* user_ptr, bool service_vn, ptl_size_t local_offset,
                ptl_size_t remote_offset);
+    ~BxiRequest();
+    void end_md_use();
+
+    // Requests are deleted through a pointer to their actual type (see ~BxiMsg), which
+    // gives us the right size class in the pool
+    static void* operator new(size_t size) { return BxiPool::allocate(size); }
+    static void operator delete(void* p, size_t size) { BxiPool::release(p, size); }
 };
 
 class BxiPutRequest : public BxiRequest {
@@ -262,7 +421,7 @@ class BxiAtomicRequest : public BxiPutRequest {
 
 class BxiFetchAtomicRequest : public BxiAtomicRequest {
   public:
-    std::shared_ptr<BxiMD> get_md;
+    BxiMD* get_md;
     ptl_size_t get_local_offset;
     bool fetch_atomic_event_issued = false;
 
@@ -270,6 +429,7 @@ class BxiFetchAtomicRequest : public BxiAtomicRequest {
                           ptl_pid_t target_pid, ptl_pt_index_t pt_index, void* user_ptr, bool service_vn,
                           ptl_size_t local_offset, ptl_size_t remote_offset, ptl_hdr_data_t hdr, ptl_op_t op,
                           ptl_datatype_t datatype, BxiMD* get_md, ptl_size_t get_local_offset);
+    ~BxiFetchAtomicRequest();
     bool is_swap_request();
 };
 
@@ -301,6 +461,7 @@ class BxiMsg {
     ptl_nid_t target;
     uint64_t simulated_size; // In bytes
     double send_init_time;   // In seconds
+    double first_send_time;  // In seconds, send_init_time of the first transmission (before any E2E retry)
     int retry_count;
     bxi_msg_type type;
     BxiRequest* parent_request;
@@ -309,6 +470,18 @@ class BxiMsg {
     BxiMsg* answers_msg             = nullptr;
     std::shared_ptr<BxiLog> bxi_log = nullptr;
     bool is_PIO                     = false;
+    bool flowctrl_granted           = false; // Flow control credits were already taken for this message
+    bool analytic                   = false; // ACK delivered without going through the network (see BxiAckQueue)
+    // Links used when the message is stored as an unexpected header (see BxiUHStore)
+    BxiMsg* uh_prev        = nullptr;
+    BxiMsg* uh_next        = nullptr;
+    BxiMsg* uh_bucket_prev = nullptr;
+    BxiMsg* uh_bucket_next = nullptr;
+    // Links used while the message waits for its E2E timeout (see BxiTimerWheel)
+    BxiMsg* e2e_prev      = nullptr;
+    BxiMsg* e2e_next      = nullptr;
+    uint64_t e2e_deadline = 0;  // In ticks of the timer wheel
+    int e2e_slot          = -1; // -1 when the message isn't in a timer wheel
 
     BxiMsg(ptl_nid_t initiator, ptl_nid_t target, bxi_msg_type type, ptl_size_t simulated_size,
            BxiRequest* parent_request);
@@ -317,6 +490,9 @@ class BxiMsg {
 
     static void unref(BxiMsg* msg);
     bxi_vn get_vn() const;
+
+    static void* operator new(size_t size) { return BxiPool::allocate(size); }
+    static void operator delete(void* p, size_t size) { BxiPool::release(p, size); }
 };
 
 #endif // S4BXI_S4PTL_HPP
@@ -0,0 +1,69 @@
+/*
+ * Author: Julien EMMANUEL
+ * Copyright (C) 2019-2022 Bull S.A.S
+ * All rights reserved
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation,
+ * which comes with this package.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+
+#include <limits>
+
+#include "s4bxi/BxiAckQueue.hpp"
+
+using namespace std;
+using namespace simgrid;
+
+BxiAckQueue::BxiAckQueue() : wakeup(s4u::Semaphore::create(0)), planned_wakeup(numeric_limits<double>::infinity()) {}
+
+/**
+ * Can be called by any actor (usually the NIC target of the node that sends the ACK)
+ */
+void BxiAckQueue::put(BxiMsg* msg, double date)
+{
+    pending.push(Entry{date, next_seq++, msg});
+
+    // Only wake the consumer up if it would otherwise sleep past this ACK
+    if (date < planned_wakeup) {
+        planned_wakeup = date;
+        wakeup->release();
+    }
+}
+
+BxiMsg* BxiAckQueue::get()
+{
+    for (;;) {
+        if (pending.empty()) {
+            planned_wakeup = numeric_limits<double>::infinity();
+            wakeup->acquire();
+            continue;
+        }
+
+        planned_wakeup = pending.top().date;
+        double now     = s4u::Engine::get_clock();
+        // If we try to sleep for shorter than the simulation's precision SimGrid explodes
+        if (planned_wakeup > now + 1e-9 && !wakeup->acquire_timeout(planned_wakeup - now))
+            continue; // Woken up by `put`, the first date changed
+
+        auto msg = pending.top().msg;
+        pending.pop();
+
+        return msg;
+    }
+}
+
+void BxiAckQueue::clear()
+{
+    while (!pending.empty()) {
+        BxiMsg::unref(pending.top().msg);
+        pending.pop();
+    }
+}
@@ -18,9 +18,8 @@
 #include "s4bxi/actors/BxiUserAppActor.hpp"
 #include "s4bxi/s4bxi_mailbox_pool.hpp"
 
-#include <iomanip> // setprecision
-#include <cmath>   // floor
 #include <simgrid/s4u.hpp>
+#include <boost/algorithm/string.hpp>
 
 // This define thing is ugly, but I can't find an elegant way to deal with these log categories
 #define MAKE_NEW_LOG_CATEGORY
@@ -32,50 +31,65 @@ using namespace simgrid;
 
 S4BXI_LOG_NEW_DEFAULT_CATEGORY(bxi_engine, "Messages specific to BXI engine");
 
-#define LOGS_IN_FILE 10000
-
 using namespace simgrid;
 
 BxiEngine* BxiEngine::instance = nullptr;
+s4bxi_config BxiEngine::config;
+bxi_log_filter BxiEngine::log_filter;
 
-#define LOG_STRING_CONFIG(x) XBT_DEBUG("%s: %s", #x, config->x.c_str())
-#define LOG_CONFIG(x)        XBT_DEBUG("%s: %s", #x, to_string(config->x).c_str())
+#define LOG_STRING_CONFIG(x) XBT_DEBUG("%s: %s", #x, config.x.c_str())
+#define LOG_CONFIG(x)        XBT_DEBUG("%s: %s", #x, to_string(config.x).c_str())
 
 BxiEngine::BxiEngine()
 {
-    config = make_shared<s4bxi_config>();
-
-    config->max_retries               = get_int_s4bxi_param("MAX_RETRIES", 5);
-    config->retry_timeout             = get_double_s4bxi_param("RETRY_TIMEOUT", 10.0F);
-    config->use_real_memory           = get_bool_s4bxi_param("USE_REAL_MEMORY", true);
-    config->model_pci                 = get_bool_s4bxi_param("MODEL_PCI", true);
-    config->model_pci_commands        = config->model_pci && get_bool_s4bxi_param("MODEL_PCI_COMMANDS", true);
-    config->e2e_off                   = get_bool_s4bxi_param("E2E_OFF", false);
-    config->log_folder                = get_string_s4bxi_param("LOG_FOLDER", "/dev/null");
-    config->log_computation           = get_bool_s4bxi_param("LOG_COMPUTATION", true);
-    config->log_level                 = config->log_folder == "/dev/null" ? 0 : 1;
-    config->privatize_libs            = get_string_s4bxi_param("PRIVATIZE_LIBS", "");
-    config->keep_temps                = get_bool_s4bxi_param("KEEP_TEMPS", false);
-    config->max_memcpy                = get_long_s4bxi_param("MAX_MEMCPY", -1);
-    config->cpu_factor                = get_double_s4bxi_param("CPU_FACTOR", 1.0F);
-    config->cpu_threshold             = get_double_s4bxi_param("CPU_THRESHOLD", 1e-9);
-    config->cpu_accumulate            = get_bool_s4bxi_param("CPU_ACCUMULATE", false);
-    config->active_polling_delay      = get_double_s4bxi_param("ACTIVE_POLLING_DELAY", 1e-8);
-    config->quick_acks                = get_bool_s4bxi_param("QUICK_ACKS", false);
-    config->auto_shared_malloc_thresh = get_double_s4bxi_param("SHARED_MALLOC_THRESH", 1.0);
-    config->shared_malloc_hugepage    = get_string_s4bxi_param("SHARED_MALLOC_HUGEPAGE", "");
-    config->shared_malloc_blocksize   = get_long_s4bxi_param("SHARED_MALLOC_BLOCKSIZE", 1048576);
-    config->max_inflight_to_target    = get_int_s4bxi_param("MAX_INFLIGHT_TO_TARGET", 0);
-    config->max_inflight_to_process   = get_int_s4bxi_param("MAX_INFLIGHT_TO_PROCESS", 0);
-    config->no_dlclose                = get_bool_s4bxi_param("NO_DLCLOSE", false);
-    config->use_pugixml               = get_bool_s4bxi_param("USE_PUGIXML", false);
+    config.max_retries               = get_int_s4bxi_param("MAX_RETRIES", 5);
+    config.retry_timeout             = get_double_s4bxi_param("RETRY_TIMEOUT", 10.0F);
+    config.use_real_memory           = get_bool_s4bxi_param("USE_REAL_MEMORY", true);
+    config.model_pci                 = get_bool_s4bxi_param("MODEL_PCI", true);
+    config.model_pci_commands        = config.model_pci && get_bool_s4bxi_param("MODEL_PCI_COMMANDS", true);
+    config.pci_model                 = get_string_s4bxi_param("PCI_MODEL", "default");
+    config.analytic_pci              = get_bool_s4bxi_param("ANALYTIC_PCI", false);
+    config.e2e_off                   = get_bool_s4bxi_param("E2E_OFF", false);
+    config.log_folder                = get_string_s4bxi_param("LOG_FOLDER", "/dev/null");
+    config.log_computation           = get_bool_s4bxi_param("LOG_COMPUTATION", true);
+    config.log_nids                  = get_string_s4bxi_param("LOG_NIDS", "");
+    config.log_types                 = get_string_s4bxi_param("LOG_TYPES", "");
+    config.log_window                = get_string_s4bxi_param("LOG_WINDOW", "");
+    config.stats_file                = get_string_s4bxi_param("STATS", "");
+    config.log_level                 = config.log_folder == "/dev/null" && config.stats_file.empty() ? 0 : 1;
+    config.log_async                 = get_bool_s4bxi_param("LOG_ASYNC", false);
+    config.privatize_libs            = get_string_s4bxi_param("PRIVATIZE_LIBS", "");
+    config.keep_temps                = get_bool_s4bxi_param("KEEP_TEMPS", false);
+    config.max_memcpy                = get_long_s4bxi_param("MAX_MEMCPY", -1);
+    config.cpu_factor                = get_double_s4bxi_param("CPU_FACTOR", 1.0F);
+    config.cpu_threshold             = get_double_s4bxi_param("CPU_THRESHOLD", 1e-9);
+    config.cpu_accumulate            = get_bool_s4bxi_param("CPU_ACCUMULATE", false);
+    config.active_polling_delay      = get_double_s4bxi_param("ACTIVE_POLLING_DELAY", 1e-8);
+    config.quick_acks                = get_bool_s4bxi_param("QUICK_ACKS", false);
+    config.analytic_acks             = get_bool_s4bxi_param("ANALYTIC_ACKS", false);
+    config.loss_model                = get_string_s4bxi_param("LOSS_MODEL", "");
+    config.loss_seed                 = get_long_s4bxi_param("LOSS_SEED", 0);
+    config.link_faults               = get_string_s4bxi_param("LINK_FAULTS", "");
+    config.auto_shared_malloc_thresh = get_double_s4bxi_param("SHARED_MALLOC_THRESH", 1.0);
+    config.shared_malloc_hugepage    = get_string_s4bxi_param("SHARED_MALLOC_HUGEPAGE", "");
+    config.shared_malloc_blocksize   = get_long_s4bxi_param("SHARED_MALLOC_BLOCKSIZE", 1048576);
+    config.max_inflight_to_target    = get_int_s4bxi_param("MAX_INFLIGHT_TO_TARGET", 0);
+    config.max_inflight_to_process   = get_int_s4bxi_param("MAX_INFLIGHT_TO_PROCESS", 0);
+    config.no_dlclose                = get_bool_s4bxi_param("NO_DLCLOSE", false);
+    config.use_pugixml               = get_bool_s4bxi_param("USE_PUGIXML", false);
+    config.indexed_matching          = get_bool_s4bxi_param("INDEXED_MATCHING", true);
     const string s                    = get_string_s4bxi_param("SHARED_MALLOC", "none");
     if (s == "local")
-        config->shared_malloc = 1;
+        config.shared_malloc = 1;
     else if (s == "global")
-        config->shared_malloc = 2;
+        config.shared_malloc = 2;
     else
-        config->shared_malloc = 0;
+        config.shared_malloc = 0;
+
+    tracing = config.log_folder != "/dev/null";
+    build_log_filter();
+    if (!config.stats_file.empty())
+        stats = make_unique<BxiStats>();
 
     XBT_DEBUG("Engine was configured with:");
     LOG_CONFIG(max_retries);
@@ -83,9 +97,16 @@ BxiEngine::BxiEngine()
     LOG_CONFIG(use_real_memory);
     LOG_CONFIG(model_pci);
     LOG_CONFIG(model_pci_commands);
+    LOG_STRING_CONFIG(pci_model);
+    LOG_CONFIG(analytic_pci);
     LOG_CONFIG(e2e_off);
     LOG_STRING_CONFIG(log_folder);
+    LOG_STRING_CONFIG(log_nids);
+    LOG_STRING_CONFIG(log_types);
+    LOG_STRING_CONFIG(log_window);
+    LOG_STRING_CONFIG(stats_file);
     LOG_CONFIG(log_level);
+    LOG_CONFIG(log_async);
     LOG_STRING_CONFIG(privatize_libs);
     LOG_CONFIG(keep_temps);
     LOG_CONFIG(max_memcpy);
@@ -94,6 +115,10 @@ BxiEngine::BxiEngine()
     LOG_CONFIG(cpu_accumulate);
     LOG_CONFIG(active_polling_delay);
     LOG_CONFIG(quick_acks);
+    LOG_CONFIG(analytic_acks);
+    LOG_STRING_CONFIG(loss_model);
+    LOG_CONFIG(loss_seed);
+    LOG_STRING_CONFIG(link_faults);
     LOG_CONFIG(auto_shared_malloc_thresh);
     LOG_STRING_CONFIG(shared_malloc_hugepage);
     LOG_CONFIG(shared_malloc);
@@ -101,16 +126,147 @@ BxiEngine::BxiEngine()
     LOG_CONFIG(max_inflight_to_target);
     LOG_CONFIG(max_inflight_to_process);
     LOG_CONFIG(no_dlclose);
+    LOG_CONFIG(indexed_matching);
+
+    BxiLossModel::configure(config);
+}
+
+void BxiEngine::build_log_filter()
+{
+    uint32_t type_mask = 0;
+    if (config.log_types.empty()) {
+        type_mask = (1U << S4BXILOG_TYPE_COUNT) - 1;
+    } else {
+        vector<string> names;
+        boost::split(names, config.log_types, boost::is_any_of(","));
+        for (auto& name : names) {
+            boost::trim(name);
+            int type = 0;
+            while (type < S4BXILOG_TYPE_COUNT && name != bxi_log_type_name(type))
+                ++type;
+            if (type == S4BXILOG_TYPE_COUNT)
+                XBT_WARN("Unknown log type in S4BXI_LOG_TYPES: %s", name.c_str());
+            else
+                type_mask |= 1U << type;
+        }
+    }
+    if (!config.log_computation)
+        type_mask &= ~(1U << S4BXILOG_COMPUTE);
+
+    if (config.log_nids.empty()) {
+        log_filter.default_mask = type_mask;
+    } else {
+        log_filter.default_mask = 0;
+        vector<string> ranges;
+        boost::split(ranges, config.log_nids, boost::is_any_of(","));
+        for (auto& range : ranges) {
+            unsigned long first, last;
+            int n = sscanf(range.c_str(), "%lu-%lu", &first, &last);
+            if (n < 1 || (n == 2 && last < first)) {
+                XBT_WARN("Invalid NID range in S4BXI_LOG_NIDS: %s", range.c_str());
+                continue;
+            }
+            if (n == 1)
+                last = first;
+            if (last >= log_filter.nid_masks.size())
+                log_filter.nid_masks.resize(last + 1, 0);
+            for (auto nid = first; nid <= last; ++nid)
+                log_filter.nid_masks[nid] = type_mask;
+        }
+    }
+
+    if (!config.log_window.empty()) {
+        log_filter.windowed     = true;
+        log_filter.window_start = 0;
+        log_filter.window_end   = numeric_limits<double>::infinity();
+        auto colon              = config.log_window.find(':');
+        string start            = config.log_window.substr(0, colon);
+        string end              = colon == string::npos ? "" : config.log_window.substr(colon + 1);
+        if (!start.empty())
+            log_filter.window_start = stod(start);
+        if (!end.empty())
+            log_filter.window_end = stod(end);
+    }
+}
+
+void BxiEngine::log_loss_stats()
+{
+    unsigned long dropped = 0, dropped_by_faults = 0, late_deliveries = 0, retried = 0, gave_up = 0;
+    double added_latency = 0, max_added_latency = 0;
+    for (const auto& node : nodes) {
+        if (!node)
+            continue;
+
+        retried += node->e2e_retried;
+        gave_up += node->e2e_gave_up;
+        if (auto loss = node->loss_model.get()) {
+            dropped += loss->dropped;
+            dropped_by_faults += loss->dropped_by_faults;
+            late_deliveries += loss->late_deliveries;
+            added_latency += loss->added_latency;
+            max_added_latency = max(max_added_latency, loss->max_added_latency);
+        }
+    }
+
+    XBT_INFO("Lost %lu messages (%lu because of link faults), retried %lu times, gave up %lu times", dropped,
+             dropped_by_faults, retried, gave_up);
+    XBT_INFO("%lu retransmissions got through, added latency: %g s on average, %g s at most", late_deliveries,
+             late_deliveries ? added_latency / late_deliveries : 0, max_added_latency);
+}
+
+void BxiEngine::log_ack_stats()
+{
+    unsigned long analytic = 0, fallback = 0;
+    for (const auto& node : nodes) {
+        if (!node)
+            continue;
+
+        analytic += node->analytic_acks;
+        fallback += node->fallback_acks;
+    }
+
+    XBT_INFO("%lu ACKs were modeled analytically, %lu were sent on the network", analytic, fallback);
+}
+
+void BxiEngine::log_pci_stats()
+{
+    unsigned long analytic = 0, fallback = 0;
+    for (const auto& node : nodes) {
+        if (!node)
+            continue;
+
+        analytic += node->analytic_pci;
+        fallback += node->fallback_pci;
+    }
+
+    XBT_INFO("%lu PCI transfers were modeled analytically, %lu were simulated because of contention", analytic,
+             fallback);
 }
 
 void BxiEngine::end_simulation()
 {
-    if (config->log_level)
-        logFile.close();
+    size_t pending_logs = 0;
+    for (const auto& node : nodes)
+        if (node)
+            pending_logs += node->pending_pci_logs();
+    if (pending_logs)
+        XBT_WARN("%zu async transfers never completed, they are missing from the logs", pending_logs);
+
+    if (trace)
+        trace->close();
+    if (stats)
+        stats->dump(config.stats_file, simulation_rand_id, s4u::Engine::get_clock());
+    if (BxiLossModel::enabled())
+        log_loss_stats();
+    if (config.analytic_acks && !config.quick_acks)
+        log_ack_stats();
+    if (config.analytic_pci)
+        log_pci_stats();
 
     nodes.clear();
 
     free_mailbox_pool();
+    BxiPool::log_stats();
 
     delete instance;
 }
@@ -127,46 +283,94 @@ void BxiEngine::set_simulation_rand_id(string id)
 
 shared_ptr<BxiNode> BxiEngine::get_node(int nid)
 {
-    auto nodeIt = nodes.find(nid);
-    shared_ptr<BxiNode> node;
+    if (nid >= nodes.size())
+        nodes.resize(nid + 1);
 
-    if (nodeIt == nodes.end()) {
+    auto& node = nodes[nid];
+    if (!node) {
         node = make_shared<BxiNode>(nid);
-        nodes.emplace(nid, node);
 
         // For some mysterious reason everything blocks if we initialize that in
         // BxiNode's constructor, but it's fine if we do it afterwards
         node->e2e_entries = s4u::Semaphore::create(MAX_E2E_ENTRIES);
-    } else {
-        node = nodeIt->second;
     }
 
     return node;
 }
 
+/**
+ * Resolve the mailboxes of every NIC in the platform once and for all, so that
+ * NIC actors don't have to look them up by name for each message
+ */
+void BxiEngine::build_mailbox_tables()
+{
+    for (auto host : s4u::Engine::get_instance()->get_all_hosts()) {
+        const string& name = host->get_name();
+        if (boost::algorithm::ends_with(name, "_NIC"))
+            add_node_mailboxes(BxiActor::nid_from_slug(name.substr(0, name.length() - 4)));
+    }
+}
+
+void BxiEngine::add_node_mailboxes(int nid)
+{
+    if (nid >= nic_rx_mailboxes.size()) {
+        nic_rx_mailboxes.resize(nid + 1, {nullptr, nullptr, nullptr, nullptr});
+        nic_tx_mailboxes.resize(nid + 1, {nullptr, nullptr, nullptr, nullptr});
+    }
+
+    for (int vn = 0; vn < 4; ++vn) {
+        nic_rx_mailboxes[nid][vn] = s4u::Mailbox::by_name(BxiActor::nic_rx_mailbox_name(nid, (bxi_vn)vn));
+        nic_tx_mailboxes[nid][vn] = s4u::Mailbox::by_name(BxiActor::nic_tx_mailbox_name(nid, (bxi_vn)vn));
+    }
+}
+
+s4u::Mailbox* BxiEngine::get_nic_rx_mailbox(int nid, bxi_vn vn)
+{
+    // Nodes that weren't in the table (if the platform was modified after it was built) are added lazily
+    if (nid >= nic_rx_mailboxes.size() || !nic_rx_mailboxes[nid][vn])
+        add_node_mailboxes(nid);
+
+    return nic_rx_mailboxes[nid][vn];
+}
+
+s4u::Mailbox* BxiEngine::get_nic_tx_mailbox(int nid, bxi_vn vn)
+{
+    if (nid >= nic_tx_mailboxes.size() || !nic_tx_mailboxes[nid][vn])
+        add_node_mailboxes(nid);
+
+    return nic_tx_mailboxes[nid][vn];
+}
+
 void BxiEngine::register_main_actor(BxiMainActor* actor)
 {
     actors.emplace(s4u::Actor::self()->get_pid(), actor);
 }
 
-map<aid_t, BxiMainActor*> BxiEngine::main_actors_on_host(const string& hostname)
+/**
+ * Add a rank to the registry
+ *
+ * @return The local rank of the actor on its node
+ */
+int BxiEngine::register_rank(BxiMainActor* actor, int rank)
 {
-    map<aid_t, BxiMainActor*> on_host;
-    auto pred = [hostname](pair<aid_t, BxiMainActor*> const& the_pair) {
-        return the_pair.second->getSlug() == hostname;
-    };
-    copy_if(actors.begin(), actors.end(), inserter(on_host, on_host.end()), pred);
+    if (rank >= actors_by_rank.size())
+        actors_by_rank.resize(rank + 1, nullptr);
+    actors_by_rank[rank] = actor;
+
+    auto& on_host = actors_by_slug[actor->getSlug()];
+    on_host.push_back(actor);
 
-    return on_host;
+    return on_host.size() - 1;
 }
 
-set<string, less<>> BxiEngine::used_nodes()
+const vector<BxiMainActor*>& BxiEngine::main_actors_on_host(const string& hostname)
 {
-    set<string, less<>> out;
-    for (auto p : actors)
-        out.emplace(p.second->getSlug());
+    return actors_by_slug[hostname];
+}
 
-    return out;
+int BxiEngine::get_used_node_count()
+{
+    return actors_by_slug.size();
 }
 
 BxiMainActor* BxiEngine::get_current_main_actor()
@@ -188,20 +392,16 @@ BxiMainActor* BxiEngine::get_main_actor(aid_t pid)
 
 BxiMainActor* BxiEngine::get_actor_from_rank(int rank)
 {
-    for (auto actorIt : actors)
-        if (((BxiUserAppActor*)actorIt.second)->my_rank == rank)
-            return actorIt.second;
-
-    return nullptr;
+    return rank >= 0 && rank < actors_by_rank.size() ? actors_by_rank[rank] : nullptr;
 }
 
 BxiMainActor* BxiEngine::get_actor_from_slug_and_localrank(const string& slug, int localrank)
 {
-    for (auto actorIt : actors)
-        if (actorIt.second->getSlug() == slug && ((BxiUserAppActor*)actorIt.second)->my_local_rank == localrank)
-            return actorIt.second;
+    auto it = actors_by_slug.find(slug);
+    if (it == actors_by_slug.end() || localrank < 0 || localrank >= it->second.size())
+        return nullptr;
 
-    return nullptr;
+    return it->second[localrank];
 }
 
 int BxiEngine::get_main_actor_count()
@@ -254,24 +454,20 @@ string BxiEngine::get_string_s4bxi_param(const string& name, string default_val)
 
 void BxiEngine::log(const BxiLog& log)
 {
-    bool newFile = false;
-    if (logCount == 0) {
-        newFile = true;
-        logFile.open(config->log_folder + "/log_0.csv");
-    } else if (logCount % LOGS_IN_FILE == 0) {
-        newFile = true;
-        logFile.close();
-        logFile.open(config->log_folder + "/log_" + to_string((int)floor(logCount / LOGS_IN_FILE)) + ".csv");
-    }
-
-    if (newFile)
-        logFile << "operation_type,initiator_nid,target_nid,start_time,end_time" << endl;
-
-    logFile << log << endl;
-    ++logCount;
+    if (stats)
+        stats->record(log);
+    if (!tracing)
+        return;
+
+    if (!trace)
+        trace = make_unique<BxiTrace>(config.log_folder + "/trace.bin", simulation_rand_id, config.log_async);
+    trace->append(log);
 }
 
-shared_ptr<s4bxi_config> BxiEngine::get_config()
+/**
+ * Only allow a positive log level if there is a valid log folder or statistics are enabled
+ */
+void BxiEngine::set_log_level(int level)
 {
-    return get_instance()->config;
+    config.log_level = get_instance()->tracing || get_instance()->stats ? level : 0;
 }
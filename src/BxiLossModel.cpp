@@ -0,0 +1,231 @@
+/*
+ * Author: Julien EMMANUEL
+ * Copyright (C) 2019-2022 Bull S.A.S
+ * All rights reserved
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation,
+ * which comes with this package.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+
+#include <cstdio>
+#include <limits>
+#include <boost/algorithm/string.hpp>
+
+#include "s4bxi/BxiLossModel.hpp"
+#include "s4bxi/BxiEngine.hpp"
+#include "s4bxi/s4bxi_xbt_log.h"
+
+using namespace std;
+using namespace simgrid;
+
+S4BXI_LOG_NEW_DEFAULT_CATEGORY(s4bxi_loss_model, "Messages specific to the injection of lost messages");
+
+bxi_loss_kind BxiLossModel::kind = S4BXI_LOSS_NONE;
+double BxiLossModel::rate          = 0;
+double BxiLossModel::p_good_to_bad = 0;
+double BxiLossModel::p_bad_to_good = 1;
+double BxiLossModel::loss_good     = 0;
+double BxiLossModel::loss_bad      = 1;
+vector<bxi_link_fault> BxiLossModel::faults;
+unsigned long BxiLossModel::seed = 0;
+bool BxiLossModel::links_checked  = false;
+
+/**
+ * Parse a NID, a range of NIDs (`first-last`) or `*`
+ */
+static bool parse_nid_range(const string& str, ptl_nid_t* first, ptl_nid_t* last)
+{
+    if (str == "*") {
+        *first = 0;
+        *last  = numeric_limits<ptl_nid_t>::max();
+        return true;
+    }
+
+    unsigned long f, l;
+    int n = sscanf(str.c_str(), "%lu-%lu", &f, &l);
+    if (n < 1 || (n == 2 && l < f))
+        return false;
+
+    *first = f;
+    *last  = n == 2 ? l : f;
+    return true;
+}
+
+/**
+ * S4BXI_LOSS_MODEL is either `uniform:RATE` or `gilbert:P_GOOD_TO_BAD,P_BAD_TO_GOOD[,LOSS_GOOD[,LOSS_BAD]]`,
+ * and S4BXI_LINK_FAULTS is a `;`-separated list of `SRC>DST@START:END` or `LINK@START:END`, where SRC and
+ * DST are NIDs, ranges of NIDs or `*`, LINK is the name of a link of the platform, and either bound of the
+ * window can be omitted
+ */
+void BxiLossModel::configure(const s4bxi_config& config)
+{
+    seed = config.loss_seed;
+
+    const string& model = config.loss_model;
+    if (!model.empty() && model != "none") {
+        auto colon  = model.find(':');
+        string name = model.substr(0, colon);
+        string rest = colon == string::npos ? "" : model.substr(colon + 1);
+        vector<string> args;
+        if (!rest.empty())
+            boost::split(args, rest, boost::is_any_of(","));
+
+        if (name == "uniform" && args.size() == 1) {
+            kind = S4BXI_LOSS_UNIFORM;
+            rate = stod(args[0]);
+        } else if (name == "gilbert" && args.size() >= 2 && args.size() <= 4) {
+            kind          = S4BXI_LOSS_GILBERT_ELLIOTT;
+            p_good_to_bad = stod(args[0]);
+            p_bad_to_good = stod(args[1]);
+            loss_good     = args.size() > 2 ? stod(args[2]) : 0;
+            loss_bad      = args.size() > 3 ? stod(args[3]) : 1;
+        } else {
+            ptl_panic_fmt("Invalid S4BXI_LOSS_MODEL: %s\n", model.c_str());
+        }
+    }
+
+    if (!config.link_faults.empty()) {
+        vector<string> items;
+        boost::split(items, config.link_faults, boost::is_any_of(";"));
+        for (auto& item : items) {
+            boost::trim(item);
+            if (item.empty())
+                continue;
+
+            auto at    = item.rfind('@');
+            auto colon = item.find(':', at);
+            if (at == string::npos || !at || colon == string::npos)
+                ptl_panic_fmt("Invalid link fault in S4BXI_LINK_FAULTS: %s\n", item.c_str());
+
+            bxi_link_fault fault;
+            string where = item.substr(0, at);
+            auto gt      = where.find('>');
+            if (gt == string::npos) { // Link of the platform, whoever talks through it
+                fault.link = where;
+                parse_nid_range("*", &fault.src_first, &fault.src_last);
+                parse_nid_range("*", &fault.dst_first, &fault.dst_last);
+            } else if (!parse_nid_range(where.substr(0, gt), &fault.src_first, &fault.src_last) ||
+                       !parse_nid_range(where.substr(gt + 1), &fault.dst_first, &fault.dst_last)) {
+                ptl_panic_fmt("Invalid link fault in S4BXI_LINK_FAULTS: %s\n", item.c_str());
+            }
+
+            string start = item.substr(at + 1, colon - at - 1);
+            string end   = item.substr(colon + 1);
+            fault.start  = start.empty() ? 0 : stod(start);
+            fault.end    = end.empty() ? numeric_limits<double>::infinity() : stod(end);
+            faults.push_back(fault);
+        }
+    }
+
+    if (enabled() && config.e2e_off)
+        XBT_WARN("Lost messages are only injected when E2E is on, they will be ignored");
+}
+
+/**
+ * The platform isn't necessarily loaded when the model is configured, so links are checked
+ * when the first NIC creates its instance
+ */
+BxiLossModel::BxiLossModel(ptl_nid_t nid) : nid(nid), rng(seed * 1000003 + nid)
+{
+    if (links_checked)
+        return;
+
+    for (const auto& fault : faults)
+        if (!fault.link.empty() && !s4u::Link::by_name_or_null(fault.link))
+            ptl_panic_fmt("Unknown link in S4BXI_LINK_FAULTS: %s\n", fault.link.c_str());
+    links_checked = true;
+}
+
+/**
+ * If E2E is off at the initiator, nobody would ever retransmit the message. E2E ACKs
+ * aren't tracked either, and targets don't acknowledge duplicate requests again, so
+ * losing the E2E ACK of a Put without Portals ACK would lose the Put for good
+ */
+bool BxiLossModel::is_recoverable(const BxiMsg* msg) const
+{
+    return msg->type != S4BXI_E2E_ACK && !BxiEngine::get_instance()->get_node(msg->initiator)->e2e_off;
+}
+
+/**
+ * Faults bound to a link only concern messages whose route from the initiator's NIC goes
+ * through it (routes are cached by the initiator's node)
+ */
+bool BxiLossModel::link_is_down(const BxiMsg* msg) const
+{
+    double now = s4u::Engine::get_clock();
+    for (const auto& fault : faults) {
+        if (msg->initiator < fault.src_first || msg->initiator > fault.src_last || nid < fault.dst_first ||
+            nid > fault.dst_last || now < fault.start || now > fault.end)
+            continue;
+
+        if (fault.link.empty())
+            return true;
+
+        const nic_route& route = BxiEngine::get_instance()->get_node(msg->initiator)->get_nic_route(nid);
+        for (auto link : route.links)
+            if (fault.link == link->get_cname())
+                return true;
+    }
+
+    return false;
+}
+
+/**
+ * @return true if the incoming message must be considered lost
+ */
+bool BxiLossModel::drop(const BxiMsg* msg)
+{
+    if (S4BXI_GLOBAL_CONFIG(e2e_off) || !is_recoverable(msg))
+        return false;
+
+    if (link_is_down(msg)) {
+        ++dropped;
+        ++dropped_by_faults;
+        return true;
+    }
+
+    bool lost = false;
+    switch (kind) {
+    case S4BXI_LOSS_UNIFORM:
+        lost = uniform(rng) < rate;
+        break;
+    case S4BXI_LOSS_GILBERT_ELLIOTT: {
+        if (msg->initiator >= bad_links.size())
+            bad_links.resize(msg->initiator + 1, false);
+        // Transition of the link's state, then loss depending on the new state
+        bool bad = bad_links[msg->initiator] ? uniform(rng) >= p_bad_to_good : uniform(rng) < p_good_to_bad;
+        bad_links[msg->initiator] = bad;
+        lost                      = uniform(rng) < (bad ? loss_bad : loss_good);
+        break;
+    }
+    default:
+        break;
+    }
+
+    if (lost)
+        ++dropped;
+
+    return lost;
+}
+
+/**
+ * A retransmitted message got through: keep track of how late it is compared to its
+ * first transmission
+ */
+void BxiLossModel::record_delivery(const BxiMsg* msg)
+{
+    double added = msg->send_init_time - msg->first_send_time;
+
+    ++late_deliveries;
+    added_latency += added;
+    if (added > max_added_latency)
+        max_added_latency = added;
+}
@@ -14,6 +14,10 @@
  * Lesser General Public License for more details.
  */
 
+#include <climits>
+#include <limits>
+#include <xbt/config.hpp>
+
 #include "s4bxi/BxiNode.hpp"
 #include "s4bxi/s4bxi_util.hpp"
 #include "s4bxi/s4bxi_xbt_log.h"
@@ -23,33 +27,345 @@ S4BXI_LOG_NEW_DEFAULT_CATEGORY(s4bxi_bxi_node, "Messages specific to BxiNode");
 using namespace simgrid;
 using namespace std;
 
-BxiNode::BxiNode(int nid) : nid(nid), e2e_entries(s4u::Semaphore::create(MAX_E2E_ENTRIES)) {}
+BxiNode::BxiNode(int nid)
+    : nid(nid)
+    , e2e_entries(s4u::Semaphore::create(MAX_E2E_ENTRIES))
+    , pci(BxiPciModel::get(S4BXI_GLOBAL_CONFIG(pci_model)))
+{
+}
+
+void BxiNode::add_ni(BxiNI* ni)
+{
+    ni_handles.push_back(ni);
+
+    if (ni->pid >= DENSE_PID_TABLE_SIZE)
+        return;
+    if (ni->pid >= ni_by_pid.size())
+        ni_by_pid.resize(ni->pid + 1, nullptr);
+    ni_by_pid[ni->pid] = ni;
+}
+
+void BxiNode::remove_ni(BxiNI* ni)
+{
+    ni_handles.erase(remove(ni_handles.begin(), ni_handles.end(), ni));
+
+    if (ni->pid < ni_by_pid.size())
+        ni_by_pid[ni->pid] = nullptr;
+}
+
+/**
+ * @return nullptr if no NI uses this PID
+ */
+BxiNI* BxiNode::get_ni(ptl_pid_t pid) const
+{
+    if (pid < ni_by_pid.size())
+        return ni_by_pid[pid];
+    if (pid < DENSE_PID_TABLE_SIZE)
+        return nullptr;
+
+    for (auto ni : ni_handles)
+        if (ni->pid == pid)
+            return ni;
+
+    return nullptr;
+}
+
+s4u::Mailbox* BxiNode::get_nic_rx_mailbox(ptl_nid_t target, bxi_vn vn) const
+{
+    return BxiEngine::get_instance()->get_nic_rx_mailbox(target, vn);
+}
+
+s4u::Mailbox* BxiNode::get_nic_tx_mailbox(bxi_vn vn) const
+{
+    return BxiEngine::get_instance()->get_nic_tx_mailbox(nid, vn);
+}
+
+/**
+ * Route from our NIC to the NIC of `target`, looked up in the platform the first time only
+ */
+const nic_route& BxiNode::get_nic_route(ptl_nid_t target)
+{
+    auto it = nic_routes.find(target);
+    if (it != nic_routes.end())
+        return it->second;
+
+    nic_route& route = nic_routes[target];
+    route.latency    = 0;
+    nic_host->route_to(BxiEngine::get_instance()->get_node(target)->nic_host, route.links, &route.latency);
+
+    route.bandwidth = numeric_limits<double>::infinity();
+    for (auto link : route.links)
+        route.bandwidth = min(route.bandwidth, link->get_bandwidth());
+
+    return route;
+}
+
+void bxi_pci_transfer::wait() const
+{
+    if (comm) {
+        comm->wait();
+        return;
+    }
+
+    double now = s4u::Engine::get_clock();
+    // If we try to sleep for shorter than the simulation's precision SimGrid explodes
+    if (end > now + 1e-9)
+        s4u::this_actor::sleep_for(end - now);
+}
+
+const nic_route& BxiNode::get_pci_route(bool direction)
+{
+    if (pci_routes_ready)
+        return pci_routes[direction];
+
+    for (bool d : {PCI_CPU_TO_NIC, PCI_NIC_TO_CPU}) {
+        nic_route& route = pci_routes[d];
+        route.latency    = 0;
+        (d == PCI_CPU_TO_NIC ? main_host : nic_host)
+            ->route_to(d == PCI_CPU_TO_NIC ? nic_host : main_host, route.links, &route.latency);
+
+        route.bandwidth = numeric_limits<double>::infinity();
+        pci_contends[d] = false;
+        for (auto link : route.links) {
+            route.bandwidth = min(route.bandwidth, link->get_bandwidth());
+            pci_contends[d] |= link->get_sharing_policy() != s4u::Link::SharingPolicy::FATPIPE;
+        }
+    }
+
+    pci_shared = false;
+    for (auto link : pci_routes[PCI_CPU_TO_NIC].links) {
+        const auto& back = pci_routes[PCI_NIC_TO_CPU].links;
+        pci_shared |= link->get_sharing_policy() != s4u::Link::SharingPolicy::FATPIPE &&
+                      find(back.begin(), back.end(), link) != back.end();
+    }
+
+    // With cross traffic (SimGrid's default), a flow also uses 5% of its rate on the links of the way back,
+    // so a link that isn't a FATPIPE and is used in both directions gives it less than its bandwidth
+    if (pci_shared && config::get_value<bool>("network/crosstraffic")) {
+        for (bool d : {PCI_CPU_TO_NIC, PCI_NIC_TO_CPU}) {
+            nic_route& route = pci_routes[d];
+            const auto& back = pci_routes[!d].links;
+            route.bandwidth  = numeric_limits<double>::infinity();
+            for (auto link : route.links) {
+                bool both_ways  = link->get_sharing_policy() != s4u::Link::SharingPolicy::FATPIPE &&
+                                 find(back.begin(), back.end(), link) != back.end();
+                route.bandwidth = min(route.bandwidth, link->get_bandwidth() / (both_ways ? 1.05 : 1));
+            }
+        }
+    }
+    pci_routes_ready = true;
+
+    return pci_routes[direction];
+}
+
+/**
+ * What we actually transfer on the PCI links of the platform for a transfer of `size`
+ * bytes, according to our PCI model. For DMA requests `size` is the size of the payload
+ * that will be read, and what we transfer are the read requests
+ */
+uint64_t BxiNode::pci_wire_size(ptl_size_t size, bool direction, bxi_log_type type)
+{
+    uint64_t wire = type == S4BXILOG_PCI_DMA_REQUEST ? pci->read_requests_size(size) : pci->wire_size(size);
+    if (!pci->rescale)
+        return wire;
+
+    return wire * get_pci_route(direction).bandwidth / pci->bandwidth();
+}
+
+/**
+ * In analytic PCI mode, whether a transfer would have the PCI link to itself, in which case
+ * SimGrid would give it the bandwidth of the slowest link of the route. FATPIPE links never
+ * slow flows down, and when both directions don't share any link (e.g. split-duplex links)
+ * transfers only compete with the ones going the same way
+ */
+bool BxiNode::pci_is_idle(bool direction)
+{
+    if (!S4BXI_GLOBAL_CONFIG(analytic_pci))
+        return false;
+
+    get_pci_route(direction);
+    if (!pci_contends[direction])
+        return true;
+
+    double now = s4u::Engine::get_clock() + 1e-9; // Back-to-back transfers don't overlap
+    for (bool d : {direction, !direction}) {
+        if (pci_real_transfers[d] || pci_busy_until[d] > now)
+            return false;
+        if (!pci_shared)
+            break;
+    }
+
+    return true;
+}
+
+/**
+ * Account for a transfer that is modeled analytically
+ *
+ * @return Its duration
+ */
+double BxiNode::pci_analytic_transfer(uint64_t wire_size, bool direction)
+{
+    const nic_route& route = get_pci_route(direction);
+    double duration        = route.latency + wire_size / route.bandwidth;
+
+    double now                = s4u::Engine::get_clock();
+    pci_data_from[direction]  = now + route.latency;
+    pci_busy_until[direction] = now + duration;
+    ++analytic_pci;
+
+    return duration;
+}
+
+/**
+ * A transfer has to be simulated by SimGrid while analytic transfers are still in flight: SimGrid knows
+ * nothing about them, so the bytes they have left are sent by a real comm, which shares the link with the
+ * new transfer. The analytic transfers keep their end date, they aren't slowed down
+ */
+void BxiNode::pci_share_analytic_transfers(bool direction)
+{
+    double now = s4u::Engine::get_clock();
+    for (bool d : {direction, !direction}) {
+        if (pci_busy_until[d] > now + 1e-9) {
+            double from       = max(now, pci_data_from[d]);
+            auto remaining    = (uint64_t)((pci_busy_until[d] - from) * get_pci_route(d).bandwidth);
+            pci_busy_until[d] = 0;
+            if (remaining) {
+                s4u::CommPtr comm = s4u::Comm::sendto_init(d == PCI_CPU_TO_NIC ? main_host : nic_host,
+                                                           d == PCI_NIC_TO_CPU ? main_host : nic_host);
+                comm->set_payload_size(remaining);
+                comm->start();
+                ++pci_real_transfers[d];
+                watch_pci_comm(watched_pci_comm{comm, d, true, false, BxiLog()});
+            }
+        }
+        if (!pci_shared)
+            break;
+    }
+}
 
 void BxiNode::pci_transfer(ptl_size_t size, bool direction, bxi_log_type type)
 {
     s4u::Host* source = direction == PCI_CPU_TO_NIC ? main_host : nic_host;
     s4u::Host* dest   = direction == PCI_NIC_TO_CPU ? main_host : nic_host;
+    uint64_t wire     = pci_wire_size(size, direction, type);
 
     S4BXI_STARTLOG(type, nid, nid)
-    s4u::Comm::sendto(source, dest, size);
+    __bxi_log.size = size;
+    if (pci_is_idle(direction)) {
+        s4u::this_actor::sleep_for(pci_analytic_transfer(wire, direction));
+    } else if (S4BXI_GLOBAL_CONFIG(analytic_pci)) {
+        pci_share_analytic_transfers(direction);
+        ++pci_real_transfers[direction];
+        ++fallback_pci;
+        s4u::Comm::sendto(source, dest, wire);
+        --pci_real_transfers[direction];
+    } else {
+        s4u::Comm::sendto(source, dest, wire);
+    }
     S4BXI_WRITELOG()
 }
 
-simgrid::s4u::CommPtr BxiNode::pci_transfer_async(ptl_size_t size, bool direction, bxi_log_type type, bool detach)
+bxi_pci_transfer BxiNode::pci_transfer_async(ptl_size_t size, bool direction, bxi_log_type type, bool detach)
 {
-    auto comm = pci_transfer_init(size, direction, type);
-    if (S4BXI_GLOBAL_CONFIG(log_level)) {
-        ptl_nid_t nid_copy = nid;
-        s4u::Actor::create("_pci_transfer_async_actor", s4u::Host::current(), [comm, type, nid_copy]() {
-            S4BXI_STARTLOG(type, nid_copy, nid_copy)
-            comm->wait();
-            S4BXI_WRITELOG()
-        });
-    } else {
-        detach ? comm->detach() : comm->start();
+    bool must_log = S4BXI_GLOBAL_CONFIG(log_level) && BxiEngine::must_log(type, nid, nid);
+
+    BxiLog log;
+    if (must_log) {
+        log.type      = type;
+        log.initiator = nid;
+        log.target    = nid;
+        log.size      = size;
     }
 
-    return comm;
+    if (pci_is_idle(direction)) {
+        bxi_pci_transfer transfer;
+        double now   = s4u::Engine::get_clock();
+        transfer.end = now + pci_analytic_transfer(pci_wire_size(size, direction, type), direction);
+        if (must_log) {
+            log.start = now;
+            log.end   = transfer.end;
+            BxiEngine::get_instance()->log(log);
+        }
+
+        return transfer;
+    }
+
+    bxi_pci_transfer transfer;
+    transfer.comm = pci_transfer_init(size, direction, type);
+    bool tracked  = S4BXI_GLOBAL_CONFIG(analytic_pci);
+    if (tracked) {
+        pci_share_analytic_transfers(direction);
+        ++pci_real_transfers[direction];
+        ++fallback_pci;
+    }
+
+    if (!tracked && !must_log) {
+        detach ? transfer.comm->detach() : transfer.comm->start();
+        return transfer;
+    }
+
+    // Detached transfers are only started: the watcher keeps them alive until they complete
+    transfer.comm->start();
+    log.start = s4u::Engine::get_clock();
+    watch_pci_comm(watched_pci_comm{transfer.comm, direction, tracked, must_log, log});
+
+    return transfer;
+}
+
+/**
+ * Log the comm and / or stop counting it in the PCI transfers in flight when it completes. Nobody waits
+ * for detached transfers, and the other ones can be waited for long after they complete, so a daemon
+ * actor of the node waits for all of them
+ */
+void BxiNode::watch_pci_comm(watched_pci_comm&& watched)
+{
+    if (!pci_watcher_mailbox) {
+        pci_watcher_mailbox = s4u::Mailbox::by_name("pci_watcher_" + to_string(nid));
+        // On the NIC host: wakeups sent by the NIC actors don't go through any link, and the ones sent by the
+        // CPU only cross the PCI link like the comm they announce, so they never arrive after its completion
+        s4u::Actor::create("pci_watcher", nic_host, [this]() { watch_pci_comms(); });
+    }
+
+    watched_pci_comms.push_back(move(watched));
+    pci_watcher_mailbox->put_init(this, 0)->set_copy_data_callback(&s4u::Comm::copy_pointer_callback)->detach();
+}
+
+void BxiNode::watch_pci_comms()
+{
+    s4u::Actor::self()->daemonize();
+
+    void* wakeup;
+    s4u::CommPtr wakeup_comm = pci_watcher_mailbox->get_async(&wakeup);
+    vector<s4u::CommPtr> comms;
+
+    for (;;) {
+        comms.clear();
+        for (const auto& w : watched_pci_comms)
+            comms.push_back(w.comm);
+        comms.push_back(wakeup_comm);
+
+        ssize_t done = s4u::Comm::wait_any(comms);
+        if (done == (ssize_t)comms.size() - 1) { // New comms to watch
+            wakeup_comm = pci_watcher_mailbox->get_async(&wakeup);
+            continue;
+        }
+
+        // Comms are only removed here, so `done` is still the right index
+        watched_pci_comm& watched = watched_pci_comms[done];
+        if (watched.tracked)
+            --pci_real_transfers[watched.direction];
+        if (watched.must_log) {
+            watched.log.end = s4u::Engine::get_clock();
+            BxiEngine::get_instance()->log(watched.log);
+        }
+        watched_pci_comms.erase(watched_pci_comms.begin() + done);
+    }
+}
+
+size_t BxiNode::pending_pci_logs() const
+{
+    return count_if(watched_pci_comms.begin(), watched_pci_comms.end(),
+                    [](const watched_pci_comm& watched) { return watched.must_log; });
 }
 
 s4u::CommPtr BxiNode::pci_transfer_init(ptl_size_t size, bool direction, bxi_log_type type)
@@ -57,21 +373,11 @@ s4u::CommPtr BxiNode::pci_transfer_init(ptl_size_t size, bool direction, bxi_log
     s4u::Host* source = direction == PCI_CPU_TO_NIC ? main_host : nic_host;
     s4u::Host* dest   = direction == PCI_NIC_TO_CPU ? main_host : nic_host;
 
-    // See comment about broken things below
-    // S4BXI_STARTLOG(type, nid, nid)
-
     // It's important to do that, instead of sendto_async,
     // see https://framagit.org/simgrid/simgrid/-/issues/60
     // (Thanks Martin for your help on this)
     s4u::CommPtr comm = s4u::Comm::sendto_init(source, dest);
-    comm->set_payload_size(size);
-
-    // This is broken because SimGrid's signals don't do what I was expecting. Disable it completely until I make a
-    // proper plugin for logging this type of things
-    // if (__bxi_log_level) {
-    //     comm->on_completion_cb([__bxi_log_level, __bxi_log, comm](s4u::Comm const&) mutable { fprintf(stderr,
-    //     "Writing pci_transfer log for comm %p\n", comm); S4BXI_WRITELOG(); });
-    // }
+    comm->set_payload_size(pci_wire_size(size, direction, type));
 
     // Technically `detach` works too but if I do that Augustin wants to physically harm me so I guess I won't
     // Edit: do not do anything to this comm for now
@@ -80,80 +386,98 @@ s4u::CommPtr BxiNode::pci_transfer_init(ptl_size_t size, bool direction, bxi_log
     return comm;
 }
 
-void BxiNode::issue_event(BxiEQ* eq, ptl_event_t* ev)
+void BxiNode::issue_event(BxiEQ* eq, const ptl_event_t* ev)
 {
     if (eq == PTL_EQ_NONE)
         return;
 
     if (S4BXI_CONFIG_AND(this, model_pci_commands))
         pci_transfer(EVENT_SIZE, PCI_NIC_TO_CPU, S4BXILOG_PCI_EVENT);
-    eq->mailbox->put_init(ev, 0)->set_copy_data_callback(&s4u::Comm::copy_pointer_callback)->detach();
+    eq->push(ev);
+}
+
+flowctrl_destination& BxiNode::get_flowctrl_destination(bxi_vn vn, ptl_nid_t target)
+{
+    auto& destinations = flowctrl_destinations[vn];
+    if (target >= destinations.size()) {
+        int max_inflight_to_target = S4BXI_GLOBAL_CONFIG(max_inflight_to_target);
+        int credits                = max_inflight_to_target ? max_inflight_to_target : INT_MAX;
+        destinations.resize(target + 1, flowctrl_destination{credits});
+    }
+
+    return destinations[target];
+}
+
+/**
+ * When process level flow control is disabled all messages to a destination share the same flow,
+ * so `src_pid` and `dst_pid` are ignored
+ */
+flowctrl_flow& BxiNode::get_flowctrl_flow(flowctrl_destination& dest, ptl_pid_t src_pid, ptl_pid_t dst_pid)
+{
+    int max_inflight_to_process = S4BXI_GLOBAL_CONFIG(max_inflight_to_process);
+    if (!max_inflight_to_process)
+        src_pid = dst_pid = 0;
+
+    for (auto& flow : dest.flows)
+        if (flow.src_pid == src_pid && flow.dst_pid == dst_pid)
+            return flow;
+
+    XBT_DEBUG("Making flow control counter %u:%u -> ?:%u with max capacity of %d (process-level)", nid, src_pid,
+              dst_pid, max_inflight_to_process);
+    dest.flows.push_back(flowctrl_flow{src_pid, dst_pid, max_inflight_to_process ? max_inflight_to_process : INT_MAX});
+
+    return dest.flows.back();
 }
 
-bool BxiNode::check_flowctrl(const BxiMsg* msg)
+/**
+ * Take the flow control credits needed to send a message. If there aren't enough
+ * credits (or if older messages of the same flow are already waiting), the message
+ * is kept in the waiting queue of its flow, and it will be given back to the TX
+ * queue once it gets its credits (see `resume_waiting_tx_actors`)
+ *
+ * @return false if the message must not be sent right now
+ */
+bool BxiNode::check_flowctrl(BxiMsg* msg)
 {
     if (e2e_off || msg->type == S4BXI_E2E_ACK || msg->retry_count)
         return true;
 
-    bxi_vn vn = msg->get_vn();
-    shared_ptr<int> flow_control_count_node;
-    shared_ptr<int> flow_control_count_process;
-
-    // Check node-level flow-control
-    int max_inflight_to_target = S4BXI_GLOBAL_CONFIG(max_inflight_to_target);
-    if (max_inflight_to_target) {
-        auto it = flowctrl_node_counts[vn].find(msg->target);
-
-        if (it == flowctrl_node_counts[vn].end()) {
-            XBT_INFO("Making semaphore %u -> %u with max capacity of %d (node-level)", nid, msg->target,
-                     max_inflight_to_target);
-            flow_control_count_node = make_shared<int>(max_inflight_to_target);
-            flowctrl_node_counts[vn].emplace(msg->target, flow_control_count_node);
-        } else {
-            flow_control_count_node = it->second;
-        }
-
-        if (*flow_control_count_node < 0)
-            ptl_panic("Node flow control has less than 0 credits");
-        if (*flow_control_count_node == 0)
-            return false;
+    if (msg->flowctrl_granted) {
+        msg->flowctrl_granted = false;
+        return true;
     }
 
-    // Check process-level flow-control
+    int max_inflight_to_target  = S4BXI_GLOBAL_CONFIG(max_inflight_to_target);
     int max_inflight_to_process = S4BXI_GLOBAL_CONFIG(max_inflight_to_process);
-    if (max_inflight_to_process) {
-        ptl_pid_t req_src        = msg->parent_request->md->ni->pid;
-        ptl_pid_t req_target     = msg->parent_request->target_pid;
-        bool is_request_vn       = vn == S4BXI_VN_COMPUTE_REQUEST || vn == S4BXI_VN_SERVICE_REQUEST;
-        flowctrl_process_id f_id = {.src_pid = is_request_vn ? req_src : req_target,
-                                    .dst_pid = is_request_vn ? req_target : req_src,
-                                    .dst_nid = msg->target};
-
-        auto it = flowctrl_process_counts[vn].find(f_id);
-
-        if (it == flowctrl_process_counts[vn].end()) {
-            XBT_DEBUG("Making semaphore %u:%u -> %u:%u with max capacity of %d (process-level)", nid,
-                      msg->parent_request->md->ni->pid, msg->target, msg->parent_request->target_pid,
-                      max_inflight_to_process);
-            flow_control_count_process = make_shared<int>(max_inflight_to_process);
-            flowctrl_process_counts[vn].emplace(f_id, flow_control_count_process);
-        } else {
-            flow_control_count_process = it->second;
+    if (!max_inflight_to_target && !max_inflight_to_process)
+        return true;
+
+    bxi_vn vn          = msg->get_vn();
+    ptl_pid_t req_src  = msg->parent_request->md->ni->pid;
+    ptl_pid_t req_dst  = msg->parent_request->target_pid;
+    bool is_request_vn = vn == S4BXI_VN_COMPUTE_REQUEST || vn == S4BXI_VN_SERVICE_REQUEST;
+
+    auto& dest = get_flowctrl_destination(vn, msg->target);
+    auto& flow = get_flowctrl_flow(dest, is_request_vn ? req_src : req_dst, is_request_vn ? req_dst : req_src);
+
+    if (dest.credits < 0)
+        ptl_panic("Node flow control has less than 0 credits");
+    if (flow.credits < 0)
+        ptl_panic("Process flow control has less than 0 credits");
+
+    if (!flow.waiting.empty() || !dest.credits || !flow.credits) {
+        flow.waiting.push_back(msg);
+        // Only waiting for node level credits
+        if (flow.credits && !flow.ready) {
+            flow.ready = true;
+            dest.ready.push_back(&flow - dest.flows.data());
         }
 
-        if (*flow_control_count_process < 0)
-            ptl_panic("Process flow control has less than 0 credits");
-        if (*flow_control_count_process == 0)
-            return false;
+        return false;
     }
 
-    // If we have enough flow control, consume the entries
-    if (max_inflight_to_target) {
-        *flow_control_count_node -= 1;
-    }
-    if (max_inflight_to_process) {
-        *flow_control_count_process -= 1;
-    }
+    --dest.credits;
+    --flow.credits;
 
     return true;
 }
@@ -173,46 +497,65 @@ void BxiNode::release_e2e_entry(ptl_nid_t target_nid, bxi_vn vn, ptl_pid_t src_p
 
     e2e_entries->release();
 
-    int max_inflight_to_target = S4BXI_GLOBAL_CONFIG(max_inflight_to_target);
-    if (max_inflight_to_target) {
-        auto it = flowctrl_node_counts[vn].find(target_nid);
-
-        if (it == flowctrl_node_counts[vn].end())
-            ptl_panic_fmt("Trying to release a flow control entry in a non-existing counter (node-level): %u -> %u",
-                          nid, target_nid);
-
-        auto count = it->second;
-        *count += 1;
-
-        xbt_assert(*count <= max_inflight_to_target, "Counter %u -> %u has more capacity than max inflight (%u > %u)",
-                   nid, target_nid, *count, max_inflight_to_target);
-    }
-
+    int max_inflight_to_target  = S4BXI_GLOBAL_CONFIG(max_inflight_to_target);
     int max_inflight_to_process = S4BXI_GLOBAL_CONFIG(max_inflight_to_process);
-    if (max_inflight_to_process) {
-        auto it = flowctrl_process_counts[vn].find({.src_pid = src_pid, .dst_pid = dst_pid, .dst_nid = target_nid});
-
-        if (it == flowctrl_process_counts[vn].end())
-            ptl_panic_fmt(
-                "Trying to release a flow control entry in a non-existing counter (process-level): %u:%u -> %u:%u", nid,
-                src_pid, target_nid, dst_pid);
-
-        auto count = it->second;
-        *count += 1;
+    if (!max_inflight_to_target && !max_inflight_to_process)
+        return;
 
-        xbt_assert(*count <= max_inflight_to_process,
-                   "Counter %u:%u -> %u:%u has more capacity than max inflight (%u > %u)", nid, src_pid, target_nid,
-                   dst_pid, *count, max_inflight_to_process);
+    if (target_nid >= flowctrl_destinations[vn].size())
+        ptl_panic_fmt("Trying to release a flow control entry in a non-existing counter (node-level): %u -> %u", nid,
+                      target_nid);
+    auto& dest = flowctrl_destinations[vn][target_nid];
+    auto& flow = get_flowctrl_flow(dest, src_pid, dst_pid);
+
+    ++dest.credits;
+    ++flow.credits;
+
+    xbt_assert(!max_inflight_to_target || dest.credits <= max_inflight_to_target,
+               "Counter %u -> %u has more capacity than max inflight (%u > %u)", nid, target_nid, dest.credits,
+               max_inflight_to_target);
+    xbt_assert(!max_inflight_to_process || flow.credits <= max_inflight_to_process,
+               "Counter %u:%u -> %u:%u has more capacity than max inflight (%u > %u)", nid, src_pid, target_nid,
+               dst_pid, flow.credits, max_inflight_to_process);
+
+    if (!flow.waiting.empty() && !flow.ready) {
+        flow.ready = true;
+        dest.ready.push_back(&flow - dest.flows.data());
     }
-
-    if (max_inflight_to_process || max_inflight_to_target)
-        resume_waiting_tx_actors(vn);
+    resume_waiting_tx_actors(vn, dest);
 }
 
-void BxiNode::resume_waiting_tx_actors(bxi_vn vn)
+/**
+ * Give credits to the messages waiting for this destination, taking one message from each
+ * ready flow in turn, and hand them back to the TX actors
+ *
+ * Putting a message in a TX queue yields, and meanwhile check_flowctrl can add destinations or
+ * flows (which invalidates `dest` and its flows), so all credits are handed out before that
+ */
+void BxiNode::resume_waiting_tx_actors(bxi_vn vn, flowctrl_destination& dest)
 {
-    while (!flowctrl_waiting_messages[vn].empty()) {
-        tx_queues[vn]->put(flowctrl_waiting_messages[vn].front(), 0, true);
-        flowctrl_waiting_messages[vn].pop_front();
+    vector<BxiMsg*> granted;
+
+    while (dest.credits && !dest.ready.empty()) {
+        auto& flow = dest.flows[dest.ready.front()];
+        dest.ready.pop_front();
+        flow.ready = false;
+        if (flow.waiting.empty() || !flow.credits)
+            continue;
+
+        auto msg = flow.waiting.front();
+        flow.waiting.pop_front();
+        --dest.credits;
+        --flow.credits;
+        msg->flowctrl_granted = true;
+        granted.push_back(msg);
+
+        if (!flow.waiting.empty() && flow.credits) {
+            flow.ready = true;
+            dest.ready.push_back(&flow - dest.flows.data());
+        }
     }
+
+    for (auto msg : granted)
+        tx_queues[vn]->put(msg, 0, true);
 }
@@ -0,0 +1,142 @@
+/*
+ * Author: Julien EMMANUEL
+ * Copyright (C) 2019-2022 Bull S.A.S
+ * All rights reserved
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation,
+ * which comes with this package.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <vector>
+#include <boost/algorithm/string.hpp>
+
+#include "s4bxi/BxiPciModel.hpp"
+#include "s4bxi/s4bxi_util.hpp"
+
+using namespace std;
+
+// The header of a TLP with 64-bit addresses is 16B, plus 4B of framing (STP token) and 4B of LCRC
+#define TLP_OVERHEAD 24
+#define GEN3_ENCODING (128. / 130.)
+
+static const BxiPciModel presets[] = {
+    // Historical model: a single read request per DMA, and the first packet of a transfer is 512B
+    {"default", 8, GEN3_ENCODING, 16, 512, INT_MAX, 0, 64, 0, 200e-9, false},
+    {"gen3x8", 8, GEN3_ENCODING, 8, 256, 512, TLP_OVERHEAD, TLP_OVERHEAD, 0.02, 200e-9, true},
+    {"gen3x16", 8, GEN3_ENCODING, 16, 256, 512, TLP_OVERHEAD, TLP_OVERHEAD, 0.02, 200e-9, true},
+    {"gen4x8", 16, GEN3_ENCODING, 8, 256, 512, TLP_OVERHEAD, TLP_OVERHEAD, 0.02, 200e-9, true},
+    {"gen4x16", 16, GEN3_ENCODING, 16, 256, 512, TLP_OVERHEAD, TLP_OVERHEAD, 0.02, 200e-9, true},
+    {"gen5x8", 32, GEN3_ENCODING, 8, 256, 512, TLP_OVERHEAD, TLP_OVERHEAD, 0.02, 200e-9, true},
+    {"gen5x16", 32, GEN3_ENCODING, 16, 256, 512, TLP_OVERHEAD, TLP_OVERHEAD, 0.02, 200e-9, true},
+};
+
+/**
+ * In bytes per second, what's left for TLPs
+ */
+double BxiPciModel::bandwidth() const
+{
+    return transfer_rate * 1e9 * lanes * encoding / 8 * (1 - dllp_overhead);
+}
+
+/**
+ * Size on the wire of the TLPs carrying `payload` bytes (writes, or completions of a read)
+ */
+uint64_t BxiPciModel::wire_size(uint64_t payload) const
+{
+    return payload + (payload + mps - 1) / mps * tlp_overhead;
+}
+
+/**
+ * Size on the wire of the requests needed to read `payload` bytes (there is at least one)
+ */
+uint64_t BxiPciModel::read_requests_size(uint64_t payload) const
+{
+    return max<uint64_t>(1, (payload + mrrs - 1) / mrrs) * read_request_size;
+}
+
+double BxiPciModel::transfer_time(uint64_t payload) const
+{
+    return latency + wire_size(payload) / bandwidth();
+}
+
+/**
+ * Time before the first TLP of a transfer is received, which is what an actor
+ * waits for when it only needs the transfer to have started
+ */
+double BxiPciModel::first_packet_time(uint64_t payload) const
+{
+    return transfer_time(min<uint64_t>(payload, mps));
+}
+
+/**
+ * `spec` is the name of a preset (empty for `default`), optionally followed by
+ * overrides of some of its parameters, for example `gen4x16:mps=512,mrrs=4096`.
+ * Models are built once per spec and shared by every node that uses them
+ */
+const BxiPciModel* BxiPciModel::get(const string& spec)
+{
+    static map<string, unique_ptr<BxiPciModel>> models;
+
+    auto it = models.find(spec);
+    if (it != models.end())
+        return it->second.get();
+
+    auto colon  = spec.find(':');
+    string name = spec.substr(0, colon);
+    if (name.empty())
+        name = "default";
+
+    auto preset = find_if(begin(presets), end(presets), [&](const BxiPciModel& p) { return p.name == name; });
+    if (preset == end(presets))
+        ptl_panic_fmt("Unknown PCI model: %s\n", spec.c_str());
+
+    auto model  = make_unique<BxiPciModel>(*preset);
+    string rest = colon == string::npos ? "" : spec.substr(colon + 1);
+    vector<string> overrides;
+    if (!rest.empty())
+        boost::split(overrides, rest, boost::is_any_of(","));
+
+    for (const auto& item : overrides) {
+        auto eq = item.find('=');
+        if (eq == string::npos)
+            ptl_panic_fmt("Invalid parameter in PCI model %s: %s\n", spec.c_str(), item.c_str());
+        string key   = item.substr(0, eq);
+        double value = atof(item.c_str() + eq + 1);
+
+        if (key == "mps")
+            model->mps = value;
+        else if (key == "mrrs")
+            model->mrrs = value;
+        else if (key == "tlp_overhead")
+            model->tlp_overhead = value;
+        else if (key == "read_request_size")
+            model->read_request_size = value;
+        else if (key == "dllp_overhead")
+            model->dllp_overhead = value;
+        else if (key == "latency")
+            model->latency = value;
+        else
+            ptl_panic_fmt("Unknown parameter in PCI model %s: %s\n", spec.c_str(), key.c_str());
+    }
+
+    if (model->mps <= 0 || model->mrrs <= 0)
+        ptl_panic_fmt("Invalid PCI model %s: MPS and MRRS must be positive\n", spec.c_str());
+
+    auto ptr     = model.get();
+    models[spec] = move(model);
+
+    return ptr;
+}
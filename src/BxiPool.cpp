@@ -0,0 +1,125 @@
+/*
+ * Author: Julien EMMANUEL
+ * Copyright (C) 2019-2022 Bull S.A.S
+ * All rights reserved
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation,
+ * which comes with this package.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include <new>
+
+#include "s4bxi/BxiPool.hpp"
+#include "s4bxi/s4bxi_xbt_log.h"
+
+S4BXI_LOG_NEW_DEFAULT_CATEGORY(s4bxi_pool, "Messages specific to the message / request pool");
+
+#define POOL_GRANULARITY 16
+#define POOL_MAX_SIZE 512
+#define POOL_CHUNK_OBJECTS 64
+#define POOL_CLASS_COUNT (POOL_MAX_SIZE / POOL_GRANULARITY)
+
+#ifndef S4BXI_NO_POOL_ALLOCATOR
+
+struct free_slot {
+    free_slot* next;
+};
+
+struct size_class {
+    free_slot* free_list     = nullptr;
+    unsigned long in_use     = 0;
+    unsigned long high_water = 0;
+    unsigned long total      = 0;
+    unsigned long chunks     = 0;
+};
+
+static size_class classes[POOL_CLASS_COUNT];
+
+static inline size_t class_index(size_t size)
+{
+    return size ? (size - 1) / POOL_GRANULARITY : 0;
+}
+
+static void refill(size_class* c, size_t slot_size)
+{
+    auto chunk = (char*)::operator new(slot_size * POOL_CHUNK_OBJECTS);
+    for (int i = POOL_CHUNK_OBJECTS - 1; i >= 0; --i) {
+        auto slot    = (free_slot*)(chunk + i * slot_size);
+        slot->next   = c->free_list;
+        c->free_list = slot;
+    }
+    ++c->chunks;
+}
+
+void* BxiPool::allocate(size_t size)
+{
+    if (size > POOL_MAX_SIZE)
+        return ::operator new(size);
+
+    auto idx = class_index(size);
+    auto c   = &classes[idx];
+    if (!c->free_list)
+        refill(c, (idx + 1) * POOL_GRANULARITY);
+
+    auto slot    = c->free_list;
+    c->free_list = slot->next;
+    ++c->total;
+    if (++c->in_use > c->high_water)
+        c->high_water = c->in_use;
+
+    return slot;
+}
+
+void BxiPool::release(void* p, size_t size)
+{
+    if (!p)
+        return;
+
+    if (size > POOL_MAX_SIZE) {
+        ::operator delete(p);
+        return;
+    }
+
+    auto c       = &classes[class_index(size)];
+    auto slot    = (free_slot*)p;
+    slot->next   = c->free_list;
+    c->free_list = slot;
+    --c->in_use;
+}
+
+void BxiPool::log_stats()
+{
+    for (int i = 0; i < POOL_CLASS_COUNT; ++i) {
+        const auto& c = classes[i];
+        if (!c.total)
+            continue;
+        XBT_DEBUG("Size class %d bytes: %lu allocations, high-water mark %lu objects (%lu chunks), %lu still in use",
+                  (i + 1) * POOL_GRANULARITY, c.total, c.high_water, c.chunks, c.in_use);
+    }
+}
+
+#else
+
+void* BxiPool::allocate(size_t size)
+{
+    return ::operator new(size);
+}
+
+void BxiPool::release(void* p, size_t)
+{
+    ::operator delete(p);
+}
+
+void BxiPool::log_stats()
+{
+    XBT_DEBUG("Pool allocator disabled at compile time, no stats available");
+}
+
+#endif
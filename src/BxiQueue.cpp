@@ -24,9 +24,8 @@ BxiQueue::BxiQueue() : mailbox(nullptr)
     waiting = s4u::Semaphore::create(0);
 }
 
-BxiQueue::BxiQueue(const string& mailbox_name)
+BxiQueue::BxiQueue(s4u::Mailbox* mailbox) : mailbox(mailbox)
 {
-    mailbox = s4u::Mailbox::by_name(mailbox_name);
     mailbox->set_receiver(s4u::Actor::self());
 }
 
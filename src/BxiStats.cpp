@@ -0,0 +1,161 @@
+/*
+ * Author: Julien EMMANUEL
+ * Copyright (C) 2019-2022 Bull S.A.S
+ * All rights reserved
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation,
+ * which comes with this package.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "s4bxi/BxiStats.hpp"
+#include "s4bxi/s4bxi_util.hpp"
+#include "s4bxi/s4bxi_xbt_log.h"
+
+using namespace std;
+
+S4BXI_LOG_NEW_DEFAULT_CATEGORY(s4bxi_stats, "Messages specific to aggregated statistics");
+
+static inline bool is_pci(int type)
+{
+    return type >= S4BXILOG_PCI_PIO_PAYLOAD && type <= S4BXILOG_PCI_COMMAND;
+}
+
+void BxiHistogram::add(double value)
+{
+    min = count ? std::min(min, value) : value;
+    max = count ? std::max(max, value) : value;
+    sum += value;
+    ++count;
+
+    int bucket = 0;
+    if (value >= 1) {
+        int exp;
+        double f   = frexp(value, &exp); // value = f * 2^exp, with f in [0.5, 1)
+        int octave = exp - 1;
+        int sub    = (int)((2 * f - 1) * S4BXI_HISTOGRAM_SUB_BUCKETS);
+        bucket     = std::min(octave * S4BXI_HISTOGRAM_SUB_BUCKETS + sub, BUCKETS - 1);
+    }
+    ++buckets[bucket];
+}
+
+double BxiHistogram::bucket_lower_bound(int bucket)
+{
+    return ldexp(1 + (double)(bucket % S4BXI_HISTOGRAM_SUB_BUCKETS) / S4BXI_HISTOGRAM_SUB_BUCKETS,
+                 bucket / S4BXI_HISTOGRAM_SUB_BUCKETS);
+}
+
+void BxiStats::record(const BxiLog& log)
+{
+    if (log.type < 0 || log.type >= S4BXILOG_TYPE_COUNT)
+        return;
+
+    double duration = log.end - log.start;
+    latencies[log.type].add(duration * 1e9);
+
+    if (log.initiator >= nodes.size())
+        nodes.resize(log.initiator + 1);
+    auto& counters = nodes[log.initiator][log.type];
+    ++counters.count;
+    counters.bytes += log.size;
+    counters.busy_time += duration;
+
+    if (log.type < S4BXILOG_PCI_PIO_PAYLOAD) { // Network messages
+        auto& pair = pairs[(uint64_t)log.initiator << 32 | log.target];
+        ++pair.messages;
+        pair.bytes += log.size;
+    }
+}
+
+void BxiStats::dump(const string& path, const string& simulation_id, double simulated_time) const
+{
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) {
+        XBT_WARN("Couldn't open %s to write statistics", path.c_str());
+        return;
+    }
+
+    fprintf(f, "{\n  \"simulation_id\": \"%s\",\n  \"simulated_time\": %.9g,\n", simulation_id.c_str(),
+            simulated_time);
+
+    // Latencies are in ns, each bucket is [lower bound, count]
+    fprintf(f, "  \"latencies\": {");
+    bool first = true;
+    for (int type = 0; type < S4BXILOG_TYPE_COUNT; ++type) {
+        auto& h = latencies[type];
+        if (!h.count)
+            continue;
+
+        fprintf(f, "%s\n    \"%s\": {\"count\": %lu, \"mean\": %.6g, \"min\": %.6g, \"max\": %.6g, \"buckets\": [",
+                first ? "" : ",", bxi_log_type_name(type), h.count, h.sum / h.count, h.min, h.max);
+        bool first_bucket = true;
+        for (int b = 0; b < BxiHistogram::BUCKETS; ++b) {
+            if (!h.buckets[b])
+                continue;
+            fprintf(f, "%s[%.6g, %lu]", first_bucket ? "" : ", ", BxiHistogram::bucket_lower_bound(b), h.buckets[b]);
+            first_bucket = false;
+        }
+        fprintf(f, "]}");
+        first = false;
+    }
+    fprintf(f, "\n  },\n");
+
+    // PCI utilisation is the time spent in PCI transfers over the simulated time. Concurrent
+    // transfers are all accounted for, so it can go above 1 when the link is shared
+    fprintf(f, "  \"nodes\": [");
+    first = true;
+    for (size_t nid = 0; nid < nodes.size(); ++nid) {
+        double pci_busy_time = 0;
+        bool active          = false;
+        for (int type = 0; type < S4BXILOG_TYPE_COUNT; ++type) {
+            active = active || nodes[nid][type].count;
+            if (is_pci(type))
+                pci_busy_time += nodes[nid][type].busy_time;
+        }
+        if (!active)
+            continue;
+
+        fprintf(f, "%s\n    {\"nid\": %zu, \"pci_busy_time\": %.9g, \"pci_utilisation\": %.6g, \"types\": {",
+                first ? "" : ",", nid, pci_busy_time, simulated_time > 0 ? pci_busy_time / simulated_time : 0);
+        bool first_type = true;
+        for (int type = 0; type < S4BXILOG_TYPE_COUNT; ++type) {
+            auto& c = nodes[nid][type];
+            if (!c.count)
+                continue;
+            fprintf(f, "%s\"%s\": {\"count\": %lu, \"bytes\": %lu, \"busy_time\": %.9g}", first_type ? "" : ", ",
+                    bxi_log_type_name(type), c.count, c.bytes, c.busy_time);
+            first_type = false;
+        }
+        fprintf(f, "}}");
+        first = false;
+    }
+    fprintf(f, "\n  ],\n");
+
+    vector<uint64_t> keys;
+    keys.reserve(pairs.size());
+    for (auto& it : pairs)
+        keys.push_back(it.first);
+    sort(keys.begin(), keys.end());
+
+    fprintf(f, "  \"pairs\": [");
+    first = true;
+    for (auto key : keys) {
+        auto& p = pairs.at(key);
+        fprintf(f, "%s\n    {\"initiator\": %lu, \"target\": %lu, \"messages\": %lu, \"bytes\": %lu}",
+                first ? "" : ",", (unsigned long)(key >> 32), (unsigned long)(key & 0xFFFFFFFF), p.messages, p.bytes);
+        first = false;
+    }
+    fprintf(f, "\n  ]\n}\n");
+
+    fclose(f);
+}
@@ -0,0 +1,178 @@
+/*
+ * Author: Julien EMMANUEL
+ * Copyright (C) 2019-2022 Bull S.A.S
+ * All rights reserved
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation,
+ * which comes with this package.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+
+#include "s4bxi/BxiTimerWheel.hpp"
+#include "s4bxi/s4bxi_util.hpp"
+
+using namespace std;
+
+void BxiTimerWheel::link(BxiMsg* msg)
+{
+    uint64_t diff = msg->e2e_deadline ^ current;
+    int level     = diff ? (63 - __builtin_clzll(diff)) / LEVEL_BITS : 0;
+    if (level >= LEVELS)
+        ptl_panic("E2E deadline is too far away for the timer wheel\n");
+    int slot = (msg->e2e_deadline >> (level * LEVEL_BITS)) & (SLOTS - 1);
+
+    Chain& chain  = slots[level][slot];
+    msg->e2e_prev = chain.tail;
+    msg->e2e_next = nullptr;
+    if (chain.tail)
+        chain.tail->e2e_next = msg;
+    else
+        chain.head = msg;
+    chain.tail = msg;
+
+    occupied[level] |= 1ULL << slot;
+    msg->e2e_slot = level * SLOTS + slot;
+}
+
+void BxiTimerWheel::unlink(BxiMsg* msg)
+{
+    int level    = msg->e2e_slot / SLOTS;
+    int slot     = msg->e2e_slot % SLOTS;
+    Chain& chain = slots[level][slot];
+
+    if (msg->e2e_prev)
+        msg->e2e_prev->e2e_next = msg->e2e_next;
+    else
+        chain.head = msg->e2e_next;
+    if (msg->e2e_next)
+        msg->e2e_next->e2e_prev = msg->e2e_prev;
+    else
+        chain.tail = msg->e2e_prev;
+
+    if (!chain.head)
+        occupied[level] &= ~(1ULL << slot);
+    msg->e2e_prev = nullptr;
+    msg->e2e_next = nullptr;
+    msg->e2e_slot = -1;
+}
+
+/**
+ * Lowest level that has a non-empty slot, and the tick at which its first
+ * non-empty slot must be processed (cascaded or expired). Lower levels always
+ * come first, because all their deadlines are before the start of any slot of
+ * a higher level
+ *
+ * @return -1 if the wheel is empty
+ */
+int BxiTimerWheel::next_level(uint64_t* when) const
+{
+    for (int level = 0; level < LEVELS; ++level) {
+        if (!occupied[level])
+            continue;
+
+        int shift      = level * LEVEL_BITS;
+        uint64_t slot  = __builtin_ctzll(occupied[level]);
+        uint64_t upper = current >> (shift + LEVEL_BITS) << (shift + LEVEL_BITS);
+        *when          = upper | slot << shift;
+
+        return level;
+    }
+
+    return -1;
+}
+
+/**
+ * Deadlines in the past are expired at the next call to `advance`
+ */
+void BxiTimerWheel::insert(BxiMsg* msg, uint64_t deadline)
+{
+    msg->e2e_deadline = deadline < current ? current : deadline;
+    link(msg);
+    ++count;
+}
+
+/**
+ * @return false if the message wasn't in the wheel
+ */
+bool BxiTimerWheel::remove(BxiMsg* msg)
+{
+    if (msg->e2e_slot < 0)
+        return false;
+
+    unlink(msg);
+    --count;
+
+    return true;
+}
+
+/**
+ * Tick at which the wheel has to be advanced next (the wheel must not be empty). This
+ * can be earlier than the first deadline, when a higher level needs to be cascaded
+ */
+uint64_t BxiTimerWheel::next_expiry() const
+{
+    uint64_t when = current;
+    next_level(&when);
+
+    return when;
+}
+
+/**
+ * Move time forward to `now`, and append every message whose deadline is
+ * not after `now` to `expired` (in deadline order)
+ */
+void BxiTimerWheel::advance(uint64_t now, vector<BxiMsg*>& expired)
+{
+    uint64_t when;
+    int level;
+    while ((level = next_level(&when)) >= 0 && when <= now) {
+        current            = when;
+        int slot           = (when >> (level * LEVEL_BITS)) & (SLOTS - 1);
+        auto msg           = slots[level][slot].head;
+        slots[level][slot] = Chain();
+        occupied[level] &= ~(1ULL << slot);
+
+        while (msg) {
+            auto next = msg->e2e_next;
+            if (level) { // Cascade to a lower level, relatively to the new current tick
+                link(msg);
+            } else {
+                msg->e2e_prev = nullptr;
+                msg->e2e_next = nullptr;
+                msg->e2e_slot = -1;
+                --count;
+                expired.push_back(msg);
+            }
+            msg = next;
+        }
+    }
+
+    if (now > current)
+        current = now;
+}
+
+void BxiTimerWheel::clear()
+{
+    for (int level = 0; level < LEVELS; ++level) {
+        for (auto& chain : slots[level]) {
+            for (auto msg = chain.head; msg;) {
+                auto next     = msg->e2e_next;
+                msg->e2e_prev = nullptr;
+                msg->e2e_next = nullptr;
+                msg->e2e_slot = -1;
+                BxiMsg::unref(msg);
+                msg = next;
+            }
+            chain = Chain();
+        }
+        occupied[level] = 0;
+    }
+    count = 0;
+}
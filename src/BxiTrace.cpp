@@ -0,0 +1,134 @@
+/*
+ * Author: Julien EMMANUEL
+ * Copyright (C) 2019-2022 Bull S.A.S
+ * All rights reserved
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation,
+ * which comes with this package.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include <cstring>
+
+#include "s4bxi/BxiTrace.hpp"
+#include "s4bxi/s4bxi_util.hpp"
+#include "s4bxi/s4bxi_xbt_log.h"
+
+using namespace std;
+
+S4BXI_LOG_NEW_DEFAULT_CATEGORY(s4bxi_trace, "Messages specific to the binary trace");
+
+#define TRACE_BUFFER_RECORDS (1 << 16) // 2 MiB per buffer
+
+BxiTrace::BxiTrace(const string& path, const string& simulation_id, bool async)
+    : buffer(TRACE_BUFFER_RECORDS), async(async)
+{
+    file = fopen(path.c_str(), "wb");
+    if (!file)
+        ptl_panic_fmt("Couldn't open trace file %s", path.c_str());
+    setvbuf(file, nullptr, _IONBF, 0); // We only do big writes anyway
+
+    bxi_trace_header header = {};
+    memcpy(header.magic, S4BXI_TRACE_MAGIC, sizeof(header.magic));
+    header.version     = S4BXI_TRACE_VERSION;
+    header.record_size = sizeof(bxi_trace_record);
+    strncpy(header.simulation_id, simulation_id.c_str(), sizeof(header.simulation_id) - 1);
+    if (fwrite(&header, sizeof(header), 1, file) != 1)
+        ptl_panic_fmt("Couldn't write header of trace file %s", path.c_str());
+
+    if (async) {
+        pending.resize(TRACE_BUFFER_RECORDS);
+        writer = thread(&BxiTrace::writer_loop, this);
+    }
+}
+
+BxiTrace::~BxiTrace()
+{
+    close();
+}
+
+/**
+ * Runs in the writer thread in async mode, so no SimGrid / XBT call in there
+ */
+void BxiTrace::write_records(const bxi_trace_record* records, size_t count)
+{
+    if (count && fwrite(records, sizeof(bxi_trace_record), count, file) != count)
+        failed = true;
+}
+
+void BxiTrace::writer_loop()
+{
+    unique_lock<mutex> lock(writer_mutex);
+    for (;;) {
+        writer_cv.wait(lock, [this] { return pending_used || closing; });
+        if (!pending_used) // Closing and nothing left to write
+            return;
+
+        size_t count = pending_used;
+        lock.unlock();
+        write_records(pending.data(), count);
+        lock.lock();
+
+        pending_used = 0;
+        writer_cv.notify_all();
+    }
+}
+
+/**
+ * Write the current buffer, or hand it to the writer thread and keep
+ * logging in the other one
+ */
+void BxiTrace::flush()
+{
+    if (!async) {
+        write_records(buffer.data(), used);
+        used = 0;
+        return;
+    }
+
+    unique_lock<mutex> lock(writer_mutex);
+    // The previous buffer might still be on its way to the disk
+    writer_cv.wait(lock, [this] { return pending_used == 0; });
+    swap(buffer, pending);
+    pending_used = used;
+    used         = 0;
+    writer_cv.notify_all();
+}
+
+void BxiTrace::close()
+{
+    if (!file)
+        return;
+
+    flush();
+    if (async) {
+        {
+            lock_guard<mutex> lock(writer_mutex);
+            closing = true;
+        }
+        writer_cv.notify_all();
+        writer.join();
+    }
+
+    if (failed)
+        XBT_WARN("Some records couldn't be written to the trace, it is incomplete");
+
+    fclose(file);
+    file = nullptr;
+}
+
+/**
+ * @return false if the file doesn't start with a header this version understands
+ */
+bool BxiTrace::read_header(FILE* f, bxi_trace_header* header)
+{
+    return fread(header, sizeof(*header), 1, f) == 1 &&
+           !strncmp(header->magic, S4BXI_TRACE_MAGIC, sizeof(header->magic)) &&
+           header->version == S4BXI_TRACE_VERSION && header->record_size == sizeof(bxi_trace_record);
+}
@@ -54,6 +54,23 @@ BxiActor::BxiActor()
 
     // NID setup
 
+    int nid = nid_from_slug(slug);
+
+    node = BxiEngine::get_instance()->get_node(nid);
+
+    if (is_main_actor) {
+        // This is very much an ugly hack, the core 0 should not be special, but whatever
+        node->main_host = s4u::Host::by_name(has_separate_cores ? slug + "_CPU0" : slug);
+    }
+    node->nic_host = s4u::Host::by_name(slug + "_NIC");
+}
+
+/**
+ * Get the NID of a node from its slug: use the `nid` property of its NIC host if it is set
+ * in the platform, otherwise guess it from the first blob of numbers in the slug
+ */
+int BxiActor::nid_from_slug(const string& slug)
+{
     int nid;
 
     const char* prop = s4u::Host::by_name(slug + "_NIC")->get_property("nid");
@@ -78,23 +95,7 @@ BxiActor::BxiActor()
         ss_nid >> nid;
     }
 
-    node = BxiEngine::get_instance()->get_node(nid);
-
-    if (is_main_actor) {
-        // This is very much an ugly hack, the core 0 should not be special, but whatever
-        node->main_host = s4u::Host::by_name(has_separate_cores ? slug + "_CPU0" : slug);
-    }
-    node->nic_host = s4u::Host::by_name(slug + "_NIC");
-}
-
-string BxiActor::nic_tx_mailbox_name(const bxi_vn vn)
-{
-    return nic_tx_mailbox_name(node->nid, vn);
-}
-
-string BxiActor::nic_rx_mailbox_name(const bxi_vn vn)
-{
-    return nic_rx_mailbox_name(node->nid, vn);
+    return nid;
 }
 
 string BxiActor::nic_tx_mailbox_name(const int nid, const bxi_vn vn)
@@ -107,7 +108,7 @@ string BxiActor::nic_rx_mailbox_name(const int nid, const bxi_vn vn)
     return to_string(nid) + "_nic_rx_" + to_string(vn);
 }
 
-void BxiActor::issue_event(BxiEQ* eq, ptl_event_t* ev)
+void BxiActor::issue_event(BxiEQ* eq, const ptl_event_t* ev)
 {
     node->issue_event(eq, ev);
 }
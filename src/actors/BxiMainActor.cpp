@@ -50,6 +50,10 @@ BxiMainActor::BxiMainActor(const vector<string>& args)
     prop                     = self->get_property("model_pci_commands");
     node->model_pci_commands = node->model_pci && (!prop || TRUTHY_CHAR(prop));
 
+    prop = self->get_property("pci_model");
+    if (prop)
+        node->pci = BxiPciModel::get(prop);
+
     prop         = self->get_property("service_mode");
     service_mode = prop && TRUTHY_CHAR(prop);
 
@@ -231,7 +235,7 @@ int BxiMainActor::PtlNIInit(ptl_interface_t iface, unsigned int options, ptl_pid
 
     auto ni    = BxiNI::init(node, iface, options, pid, desired, actual);
     *ni_handle = ni;
-    node->ni_handles.push_back(ni);
+    node->add_ni(ni);
 
     return PTL_OK;
 }
@@ -241,8 +245,8 @@ int BxiMainActor::PtlNIFini(ptl_handle_ni_t handle)
     issue_portals_command();
 
     node->used_pids.erase(remove(node->used_pids.begin(), node->used_pids.end(), ((BxiNI*)handle)->pid));
+    node->remove_ni((BxiNI*)handle);
     BxiNI::fini(handle);
-    node->ni_handles.erase(remove(node->ni_handles.begin(), node->ni_handles.end(), handle));
 
     return PTL_OK;
 }
@@ -268,14 +272,22 @@ int BxiMainActor::PtlPTEnable(ptl_handle_ni_t ni_handle, ptl_pt_index_t pt_index
 {
     issue_portals_command();
 
-    return BxiPT::getFromNI(ni_handle, pt_index)->enable();
+    BxiPT* pt = BxiPT::getFromNI(ni_handle, pt_index);
+    if (!pt)
+        return PTL_ARG_INVALID;
+
+    return pt->enable();
 }
 
 int BxiMainActor::PtlPTDisable(ptl_handle_ni_t ni_handle, ptl_pt_index_t pt_index)
 {
     issue_portals_command();
 
-    return BxiPT::getFromNI(ni_handle, pt_index)->disable();
+    BxiPT* pt = BxiPT::getFromNI(ni_handle, pt_index);
+    if (!pt)
+        return PTL_ARG_INVALID;
+
+    return pt->disable();
 }
 
 int BxiMainActor::PtlPTFree(ptl_handle_ni_t ni_handle, ptl_index_t pt_index)
@@ -289,11 +301,11 @@ int BxiMainActor::PtlPTFree(ptl_handle_ni_t ni_handle, ptl_index_t pt_index)
 // ===== EQ =====
 // ==============
 
-int BxiMainActor::PtlEQAlloc(ptl_handle_ni_t ni_handle, ptl_size_t, ptl_handle_eq_t* eq_handle)
+int BxiMainActor::PtlEQAlloc(ptl_handle_ni_t ni_handle, ptl_size_t count, ptl_handle_eq_t* eq_handle)
 {
     issue_portals_command();
 
-    *eq_handle = new BxiEQ;
+    *eq_handle = new BxiEQ(count);
 
     return PTL_OK;
 }
@@ -321,7 +333,7 @@ int BxiMainActor::PtlEQGet(ptl_handle_eq_t eq_handle, ptl_event_t* event)
     s4u::this_actor::sleep_for(active_polling_delay + (poll_count > 5 ? ((poll_count - 5) * active_polling_delay) : 0));
     auto ret = ((BxiEQ*)eq_handle)->get(event);
 
-    if (ret == PTL_OK) {
+    if (ret != PTL_EQ_EMPTY) {
         poll_count = 0;
     }
 
@@ -330,13 +342,13 @@ int BxiMainActor::PtlEQGet(ptl_handle_eq_t eq_handle, ptl_event_t* event)
 
 int BxiMainActor::PtlEQWait(ptl_handle_eq_t eq_handle, ptl_event_t* event)
 {
-    return ((BxiEQ*)eq_handle)->wait(event);
+    return ((BxiEQ*)eq_handle)->wait(event, get_waiter());
 }
 
 int BxiMainActor::PtlEQPoll(const ptl_handle_eq_t* eq_handles, unsigned int size, ptl_time_t timeout,
                             ptl_event_t* event, unsigned int* which)
 {
-    return BxiEQ::poll(eq_handles, size, timeout, event, which);
+    return BxiEQ::poll(eq_handles, size, timeout, event, which, get_waiter());
 }
 
 // ==============
@@ -356,9 +368,7 @@ int BxiMainActor::PtlMDRelease(ptl_handle_md_t md_handle)
 {
     issue_portals_command();
 
-    delete (BxiMD*)md_handle;
-
-    return PTL_OK;
+    return BxiMD::release((BxiMD*)md_handle);
 }
 
 // ===================
@@ -376,12 +386,20 @@ int BxiMainActor::PtlLEUnlink(ptl_handle_le_t le_handle)
     return PtlMEUnlink((ptl_handle_me_t)le_handle);
 }
 
+int BxiMainActor::PtlLESearch(ptl_handle_ni_t ni_handle, ptl_pt_index_t pt_index, const ptl_le_t* le_t,
+                              ptl_search_op_t op, void* user_ptr)
+{
+    return PtlMESearch(ni_handle, pt_index, (ptl_me_t*)le_t, op, user_ptr);
+}
+
 int BxiMainActor::PtlMEAppend(ptl_handle_ni_t ni_handle, ptl_index_t pt_index, const ptl_me_t* me_t, ptl_list_t list,
                               void* user_ptr, ptl_handle_me_t* me_handle)
 {
     issue_portals_command();
 
-    BxiPT* pt = ((BxiNI*)ni_handle)->pt_indexes.at(pt_index);
+    BxiPT* pt = BxiPT::getFromNI(ni_handle, pt_index);
+    if (!pt)
+        return PTL_ARG_INVALID;
     BxiME::append(pt, me_t, list, user_ptr, me_handle);
 
     return PTL_OK;
@@ -391,21 +409,35 @@ int BxiMainActor::PtlMEUnlink(ptl_handle_le_t me_handle)
 {
     issue_portals_command();
 
-    auto me  = (BxiME*)me_handle;
-    auto uhs = me->pt->unexpected_headers;
+    auto me = (BxiME*)me_handle;
 
     // This is kind of greedy, I think we should associate UHs and MEs earlier instead
     // of deciding if they match in a somewhat "lazy" way
-    if (me->list == PTL_OVERFLOW_LIST)
-        for (BxiMsg* uh : me->pt->unexpected_headers)
-            if (me->matches_request(uh->parent_request))
-                return PTL_IN_USE;
+    if (me->list == PTL_OVERFLOW_LIST && me->pt->unexpected_headers.first_match(me))
+        return PTL_IN_USE;
 
     BxiME::unlink(me_handle);
 
     return PTL_OK;
 }
 
+int BxiMainActor::PtlMESearch(ptl_handle_ni_t ni_handle, ptl_pt_index_t pt_index, const ptl_me_t* me_t,
+                              ptl_search_op_t op, void* user_ptr)
+{
+    issue_portals_command();
+
+    if (op != PTL_SEARCH_ONLY && op != PTL_SEARCH_DELETE)
+        return PTL_ARG_INVALID;
+
+    BxiPT* pt = BxiPT::getFromNI(ni_handle, pt_index);
+    if (!pt)
+        return PTL_ARG_INVALID;
+
+    pt->search(me_t, op, user_ptr);
+
+    return PTL_OK;
+}
+
 // ====================
 // ===== Requests =====
 // ====================
@@ -432,7 +464,7 @@ int BxiMainActor::PtlPut(ptl_handle_md_t md_handle, ptl_size_t local_offset, ptl
         node->pci_transfer_async(request->payload_size - inline_size, PCI_CPU_TO_NIC, S4BXILOG_PCI_PIO_PAYLOAD, true);
         // The blocking phase is very short in reality because our PCI latencies are a bit overestimated (to account for
         // many phenomenons)
-        s4u::this_actor::sleep_for(200e-9);
+        s4u::this_actor::sleep_for(node->pci->latency);
     }
     S4BXI_STARTLOG(S4BXILOG_PCI_COMMAND, node->nid, node->nid)
     // node->resume_waiting_tx_actors(vn);
@@ -545,10 +577,9 @@ int BxiMainActor::PtlSwap(ptl_handle_md_t get_mdh, ptl_size_t get_loffs, ptl_han
     bool matching                   = HAS_PTL_OPTION(m_put->ni, PTL_NI_MATCHING);
     const ptl_process_t target_proc = m_put->ni->get_physical_proc(target_id);
 
-    auto request =
-        new BxiFetchAtomicRequest(m_put, length, matching, match_bits, target_proc.phys.pid, pt_index, user_ptr,
-                                  service_mode, put_loffs, roffs, hdr, op, datatype, m_get, get_loffs);
-    auto msg = new BxiMsg(node->nid, target_proc.phys.nid, S4BXI_PTL_FETCH_ATOMIC, length, request);
+    auto request = new BxiSwapRequest(m_put, length, matching, match_bits, target_proc.phys.pid, pt_index, user_ptr,
+                                      service_mode, put_loffs, roffs, hdr, op, datatype, m_get, get_loffs, cst);
+    auto msg     = new BxiMsg(node->nid, target_proc.phys.nid, S4BXI_PTL_FETCH_ATOMIC, length, request);
     // s4bxi_fprintf(stderr, " <<< Created message %p (%s) >>>\n", msg, msg_type_c_str(msg));
 
     m_put->ni->cq->acquire();
@@ -620,6 +651,14 @@ int BxiMainActor::PtlGetNB(ptl_handle_md_t md_handle, ptl_size_t s, ptl_size_t s
 // ===== CT =====
 // ==============
 
+const shared_ptr<BxiWaiter>& BxiMainActor::get_waiter()
+{
+    if (!waiter)
+        waiter = make_shared<BxiWaiter>();
+
+    return waiter;
+}
+
 int BxiMainActor::PtlCTAlloc(ptl_handle_ni_t ni_handle, ptl_handle_ct_t* ct_handle)
 {
     issue_portals_command();
@@ -647,13 +686,13 @@ int BxiMainActor::PtlCTGet(ptl_handle_ct_t ct_handle, ptl_ct_event_t* event)
 
 int BxiMainActor::PtlCTWait(ptl_handle_ct_t ct_handle, ptl_size_t test, ptl_ct_event_t* event)
 {
-    return ((BxiCT*)ct_handle)->wait(test, event);
+    return ((BxiCT*)ct_handle)->wait(test, event, get_waiter());
 }
 
 int BxiMainActor::PtlCTPoll(const ptl_handle_ct_t* ct_handles, const ptl_size_t* tests, unsigned int size,
                             ptl_time_t timeout, ptl_ct_event_t* event, unsigned int* which)
 {
-    return BxiCT::poll(ct_handles, tests, size, timeout, event, which);
+    return BxiCT::poll(ct_handles, tests, size, timeout, event, which, get_waiter());
 }
 
 int BxiMainActor::PtlCTSet(ptl_handle_ct_t ct_handle, ptl_ct_event_t new_ct)
@@ -40,18 +40,18 @@ void BxiNicActor::maybe_issue_get(BxiGetRequest* req)
     if (req->matched_me && req->matched_me->me && !HAS_PTL_OPTION(req->matched_me->me, PTL_ME_EVENT_COMM_DISABLE) &&
         !HAS_PTL_OPTION(req->matched_me->me, PTL_ME_EVENT_SUCCESS_DISABLE) &&
         req->matched_me->list == PTL_PRIORITY_LIST) { // OVERFLOW ME will have a GET_OVERFLOW later
-        auto event           = new ptl_event_t;
-        event->initiator     = ptl_process_t{.phys{.nid = req->md->ni->node->nid, .pid = req->md->ni->pid}};
-        event->type          = PTL_EVENT_GET;
-        event->ni_fail_type  = PTL_OK;
-        event->pt_index      = req->matched_me->pt->index;
-        event->user_ptr      = req->matched_me->user_ptr;
-        event->rlength       = req->payload_size;
-        event->mlength       = req->mlength;
-        event->remote_offset = req->remote_offset;
-        event->match_bits    = req->match_bits;
-        event->start         = req->start;
-        node->issue_event(req->matched_me->pt->eq, event);
+        ptl_event_t event;
+        event.initiator     = ptl_process_t{.phys{.nid = req->md->ni->node->nid, .pid = req->md->ni->pid}};
+        event.type          = PTL_EVENT_GET;
+        event.ni_fail_type  = PTL_OK;
+        event.pt_index      = req->matched_me->pt->index;
+        event.user_ptr      = req->matched_me->user_ptr;
+        event.rlength       = req->payload_size;
+        event.mlength       = req->mlength;
+        event.remote_offset = req->remote_offset;
+        event.match_bits    = req->match_bits;
+        event.start         = req->start;
+        node->issue_event(req->matched_me->pt->eq, &event);
     }
 }
 
@@ -66,47 +66,55 @@ void BxiNicActor::maybe_issue_fetch_atomic(BxiFetchAtomicRequest* req)
     if (req->matched_me && req->matched_me->me && !HAS_PTL_OPTION(req->matched_me->me, PTL_ME_EVENT_COMM_DISABLE) &&
         !HAS_PTL_OPTION(req->matched_me->me, PTL_ME_EVENT_SUCCESS_DISABLE) &&
         req->matched_me->list == PTL_PRIORITY_LIST) { // OVERFLOW ME will have a FETCH_ATOMIC_OVERFLOW later
-        auto event           = new ptl_event_t;
-        event->initiator     = ptl_process_t{.phys{.nid = req->md->ni->node->nid, .pid = req->md->ni->pid}};
-        event->type          = PTL_EVENT_FETCH_ATOMIC;
-        event->ni_fail_type  = PTL_OK;
-        event->pt_index      = req->matched_me->pt->index;
-        event->user_ptr      = req->matched_me->user_ptr;
-        event->hdr_data      = req->hdr;
-        event->rlength       = req->payload_size;
-        event->mlength       = req->mlength;
-        event->remote_offset = req->remote_offset;
-        event->match_bits    = req->match_bits;
-        event->start         = req->start;
-        node->issue_event(req->matched_me->pt->eq, event);
+        ptl_event_t event;
+        event.initiator     = ptl_process_t{.phys{.nid = req->md->ni->node->nid, .pid = req->md->ni->pid}};
+        event.type          = PTL_EVENT_FETCH_ATOMIC;
+        event.ni_fail_type  = PTL_OK;
+        event.pt_index      = req->matched_me->pt->index;
+        event.user_ptr      = req->matched_me->user_ptr;
+        event.hdr_data      = req->hdr;
+        event.rlength       = req->payload_size;
+        event.mlength       = req->mlength;
+        event.remote_offset = req->remote_offset;
+        event.match_bits    = req->match_bits;
+        event.start         = req->start;
+        node->issue_event(req->matched_me->pt->eq, &event);
     }
 }
 
-void BxiNicActor::reliable_comm(BxiMsg* msg)
+template <typename Policy> void BxiNicActor::reliable_comm(BxiMsg* msg)
 {
-    S4BXI_STARTLOG((bxi_log_type)msg->type, msg->initiator, msg->target);
-    //             ^^^^^^^^^^^^^^
+    S4BXI_STARTLOG_IF(Policy::log, (bxi_log_type)msg->type, msg->initiator, msg->target);
+    //                             ^^^^^^^^^^^^^^
     // This highly unsafe cast is why the beginning of the bxi_log_type
     // enum must be the exact copy of the bxi_msg_type enum
-    reliable_comm_init(msg, false)->wait();
+    __bxi_log.size = msg->simulated_size;
+    reliable_comm_init<Policy>(msg, false)->wait();
     S4BXI_WRITELOG();
 }
 
-void BxiNicActor::shallow_reliable_comm(BxiMsg* msg)
+template <typename Policy> void BxiNicActor::shallow_reliable_comm(BxiMsg* msg)
 {
-    reliable_comm_init(msg, true)->wait();
+    reliable_comm_init<Policy>(msg, true)->wait();
 }
 
-s4u::CommPtr BxiNicActor::reliable_comm_init(BxiMsg* msg, bool shallow)
+template <typename Policy> s4u::CommPtr BxiNicActor::reliable_comm_init(BxiMsg* msg, bool shallow)
 {
     s4u::this_actor::sleep_for(2e-9);
     // BXI_ACKs don't have any higher level of ACK, so no E2E logic
-    //                    ⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄
-    if (!node->e2e_off && msg->type != S4BXI_E2E_ACK) {
+    //                                     ⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄⌄
+    if (Policy::e2e && !node->e2e_off && msg->type != S4BXI_E2E_ACK) {
         node->e2e_actor->process_message(msg);
     }
 
-    return s4u::Mailbox::by_name(nic_rx_mailbox_name(msg->target, vn))
+    return node->get_nic_rx_mailbox(msg->target, vn)
         ->put_init(msg, shallow ? 0 : msg->simulated_size)
         ->set_copy_data_callback(&s4u::Comm::copy_pointer_callback);
 }
+
+template void BxiNicActor::reliable_comm<BxiFullNicPolicy>(BxiMsg*);
+template void BxiNicActor::reliable_comm<BxiFastNicPolicy>(BxiMsg*);
+template void BxiNicActor::shallow_reliable_comm<BxiFullNicPolicy>(BxiMsg*);
+template void BxiNicActor::shallow_reliable_comm<BxiFastNicPolicy>(BxiMsg*);
+template s4u::CommPtr BxiNicActor::reliable_comm_init<BxiFullNicPolicy>(BxiMsg*, bool);
+template s4u::CommPtr BxiNicActor::reliable_comm_init<BxiFastNicPolicy>(BxiMsg*, bool);
@@ -14,6 +14,9 @@
  * Lesser General Public License for more details.
  */
 
+#include <cmath>
+#include <limits>
+
 #include "s4bxi/actors/BxiNicE2E.hpp"
 #include "s4bxi/s4bxi_xbt_log.h"
 
@@ -22,7 +25,14 @@ using namespace simgrid;
 
 S4BXI_LOG_NEW_DEFAULT_CATEGORY(s4bxi_nic_e2e, "Messages specific to the NIC E2E circuit");
 
-BxiNicE2E::BxiNicE2E(const vector<string>& args) : BxiActor()
+// Timeouts are rounded up to the next tick, so retransmissions are at most `retry_timeout / E2E_TICKS_PER_TIMEOUT` late
+#define E2E_TICKS_PER_TIMEOUT 1024
+
+BxiNicE2E::BxiNicE2E(const vector<string>& args)
+    : BxiActor()
+    , wakeup(s4u::Semaphore::create(0))
+    , tick(S4BXI_GLOBAL_CONFIG(retry_timeout) / E2E_TICKS_PER_TIMEOUT)
+    , planned_wakeup(numeric_limits<double>::infinity())
 {
     // If E2E was disabled globally, immediately kill any E2E actor
     // This also forces at most 1 E2E actor per node
@@ -34,10 +44,11 @@ BxiNicE2E::BxiNicE2E(const vector<string>& args) : BxiActor()
     node->e2e_actor = this;
 
     s4u::this_actor::on_exit([this](bool) {
-        if (current_msg)
-            BxiMsg::unref(current_msg);
+        for (auto msg : expired)
+            BxiMsg::unref(msg);
+        expired.clear();
 
-        queue.clear();
+        wheel.clear();
         XBT_INFO("Retried %lu times, gave up %lu times", node->e2e_retried, node->e2e_gave_up);
     });
 
@@ -50,13 +61,15 @@ BxiNicE2E::BxiNicE2E(const vector<string>& args) : BxiActor()
  *
  * It is OK to have an infinite loop since this actor is daemonized.
  *
- * One E2E actor for each NIC is enough : because `retry_timeout` is constant,
- * we know retries must be processed in the order messages are issued, so
- * waiting until the next retry doesn't break the order of timeout processing
+ * Messages wait for their timeout in a timer wheel, and the actor only wakes up
+ * when the first non-empty slot of the wheel is due: every message whose
+ * deadline passed is then processed in the same wakeup. Messages that get
+ * ACKed are removed from the wheel right away (see `cancel`), so in a run
+ * without losses the actor barely ever wakes up.
  *
- * This property is very important : if `retry_timeout` were to change between
- * messages, we would need to create a new E2E actor for each message and then
- * kill it (or make this one way more complex). Happily in the real world
+ * Because `retry_timeout` is constant, a new message never has an earlier
+ * deadline than the ones already in the wheel, so `process_message` only needs
+ * to wake the actor up when the wheel was empty. Happily in the real world
  * `retry_timeout` is a kernel module parameter, and isn't expected to change
  */
 void BxiNicE2E::operator()()
@@ -66,65 +79,59 @@ void BxiNicE2E::operator()()
         return;
 
     for (;;) {
-        auto msg    = queue.get();
-        current_msg = msg;
-
-        double wake_up_time = msg->send_init_time + S4BXI_GLOBAL_CONFIG(retry_timeout);
-
-        if (wake_up_time < s4u::Engine::get_clock()) {
-            XBT_INFO("Expected sleep > %f, got %f", s4u::Engine::get_clock(), wake_up_time);
-            ptl_panic("Negative sleep expected in E2E, this is catastrophic");
+        if (wheel.empty()) {
+            planned_wakeup = numeric_limits<double>::infinity();
+            wakeup->acquire();
+            continue;
         }
 
+        planned_wakeup = wheel.next_expiry() * tick;
+        double now     = s4u::Engine::get_clock();
         // If we try to sleep for shorter than the simulation's precision SimGrid explodes
-        if (wake_up_time > s4u::Engine::get_clock() + 1e-9)
-            s4u::this_actor::sleep_until(wake_up_time);
-
-        // Message got ACKed in time, ignore E2E processing and go to next one
-        if (msg->parent_request->process_state >=
-            (msg->type == S4BXI_PTL_ACK ? S4BXI_REQ_FINISHED : S4BXI_REQ_ANSWERED)) {
-            BxiMsg::unref(msg);
-            current_msg = nullptr;
-            continue;
-        }
+        if (planned_wakeup > now + 1e-9 && !wakeup->acquire_timeout(planned_wakeup - now))
+            continue; // Woken up by process_message, the first deadline changed
+
+        // Tolerate rounding errors, we're supposed to be right on a tick
+        wheel.advance((uint64_t)(s4u::Engine::get_clock() / tick + 1e-6), expired);
+        for (auto msg : expired)
+            handle_timeout(msg);
+        expired.clear();
+    }
+}
 
-        // All hope is lost for this message, just give up and go to the next one
-        if (msg->retry_count == S4BXI_GLOBAL_CONFIG(max_retries)) {
-            ++node->e2e_gave_up;
-            BxiMsg::unref(msg);
-            current_msg = nullptr;
-            // burn_the_whole_cluster_I_guess();
-            continue;
-        }
+void BxiNicE2E::handle_timeout(BxiMsg* msg)
+{
+    // Message got ACKed in time, ignore E2E processing and go to next one
+    if (msg->parent_request->process_state >= (msg->type == S4BXI_PTL_ACK ? S4BXI_REQ_FINISHED : S4BXI_REQ_ANSWERED)) {
+        BxiMsg::unref(msg);
+        return;
+    }
 
-        // Message didn't get an ACK yet, and can be retransmitted :
-        // give it back to BxiNicInitiator and go to the next one
-        if (msg->retry_count < S4BXI_GLOBAL_CONFIG(max_retries)) {
-            ++node->e2e_retried;
-            ++msg->retry_count;
+    // All hope is lost for this message, just give up and go to the next one
+    if (msg->retry_count == S4BXI_GLOBAL_CONFIG(max_retries)) {
+        ++node->e2e_gave_up;
+        BxiMsg::unref(msg);
+        // burn_the_whole_cluster_I_guess();
+        return;
+    }
 
-            get_retransmit_mailbox(msg)
-                ->put_init(new BxiMsg(*msg), 0)
-                ->set_copy_data_callback(&s4u::Comm::copy_pointer_callback)
-                ->detach();
+    // Message didn't get an ACK yet, and can be retransmitted :
+    // give it back to BxiNicInitiator and go to the next one
+    if (msg->retry_count < S4BXI_GLOBAL_CONFIG(max_retries)) {
+        ++node->e2e_retried;
+        ++msg->retry_count;
 
-            BxiMsg::unref(msg);
-            current_msg = nullptr;
-            continue;
-        }
+        node->get_nic_tx_mailbox(msg->get_vn())
+            ->put_init(new BxiMsg(*msg), 0)
+            ->set_copy_data_callback(&s4u::Comm::copy_pointer_callback)
+            ->detach();
 
-        XBT_INFO("Expected retry count > %d, got %d", S4BXI_GLOBAL_CONFIG(max_retries), msg->retry_count);
-        ptl_panic("Retry count is bigger than MAX_RETRY_COUNT in E2E, which shouldn't be possible");
+        BxiMsg::unref(msg);
+        return;
     }
-}
 
-s4u::Mailbox* BxiNicE2E::get_retransmit_mailbox(const BxiMsg* msg)
-{
-    bxi_vn vn = msg->get_vn();
-
-    if (!nic_cmd_mailboxes[vn])
-        nic_cmd_mailboxes[vn] = s4u::Mailbox::by_name(nic_tx_mailbox_name(vn));
-    return nic_cmd_mailboxes[vn];
+    XBT_INFO("Expected retry count > %d, got %d", S4BXI_GLOBAL_CONFIG(max_retries), msg->retry_count);
+    ptl_panic("Retry count is bigger than MAX_RETRY_COUNT in E2E, which shouldn't be possible");
 }
 
 /**
@@ -136,5 +143,25 @@ void BxiNicE2E::process_message(BxiMsg* msg)
         node->acquire_e2e_entry(msg);
     ++msg->ref_count;
     msg->send_init_time = s4u::Engine::get_clock();
-    queue.put(msg);
-}
\ No newline at end of file
+    if (!msg->retry_count)
+        msg->first_send_time = msg->send_init_time;
+
+    auto deadline = (uint64_t)ceil((msg->send_init_time + S4BXI_GLOBAL_CONFIG(retry_timeout)) / tick);
+    wheel.insert(msg, deadline);
+    if (deadline * tick < planned_wakeup) {
+        planned_wakeup = deadline * tick;
+        wakeup->release();
+    }
+}
+
+/**
+ * Used by other actors when a message was acknowledged (its request reached the
+ * state that E2E would check at the timeout), so that it leaves the wheel
+ * without waiting for its timeout. This does nothing if the message isn't
+ * waiting in the wheel (E2E is off, it was already processed, etc.)
+ */
+void BxiNicE2E::cancel(BxiMsg* msg)
+{
+    if (wheel.remove(msg))
+        BxiMsg::unref(msg);
+}
@@ -24,13 +24,14 @@ using namespace simgrid;
 
 S4BXI_LOG_NEW_DEFAULT_CATEGORY(s4bxi_nic_initiator, "Messages specific to the NIC initiator");
 
-BxiNicInitiator::BxiNicInitiator(const vector<string>& args) : BxiNicActor(args)
+template <typename Policy> BxiNicInitiator<Policy>::BxiNicInitiator(const vector<string>& args) : BxiNicActor(args)
 {
     if (node->tx_queues[vn]) {
         tx_queue = node->tx_queues[vn];
     } else {
-        tx_queue = S4BXI_CONFIG_AND(node, model_pci_commands) ? make_shared<BxiQueue>(nic_tx_mailbox_name(vn))
-                                                              : make_shared<BxiQueue>();
+        tx_queue = S4BXI_POLICY_AND(Policy, node, model_pci_commands)
+                       ? make_shared<BxiQueue>(node->get_nic_tx_mailbox(vn))
+                       : make_shared<BxiQueue>();
         node->tx_queues[vn] = tx_queue;
     }
 }
@@ -40,22 +41,15 @@ BxiNicInitiator::BxiNicInitiator(const vector<string>& args) : BxiNicActor(args)
  *
  * It is OK to have an infinite loop since this actor is daemonized
  */
-void BxiNicInitiator::operator()()
+template <typename Policy> void BxiNicInitiator<Policy>::operator()()
 {
-    auto flowctrl_msq_queue = &node->flowctrl_waiting_messages[vn];
-
     for (;;) {
         BxiMsg* msg = tx_queue->get();
 
-        if (!node->check_flowctrl(msg)) {
-            // If we ran out of flow control, simply store the message in a queue and move on, it will be the
-            // responsability of actors that wake us up to put the messages back in our queue
-
-            if (find(flowctrl_msq_queue->begin(), flowctrl_msq_queue->end(), msg) == flowctrl_msq_queue->end())
-                flowctrl_msq_queue->push_back(msg);
-
+        // If we ran out of flow control, the node keeps the message and we move on, it will be
+        // put back in our queue when it gets its credits
+        if (!node->check_flowctrl(msg))
             continue;
-        }
 
         switch (msg->type) {
         case S4BXI_PTL_PUT:
@@ -67,11 +61,11 @@ void BxiNicInitiator::operator()()
             handle_get(msg);
             break;
         case S4BXI_PTL_ACK:
-            reliable_comm(msg);
-            s4u::this_actor::sleep_for(200e-9);
+            reliable_comm<Policy>(msg);
+            s4u::this_actor::sleep_for(node->pci->latency);
             break;
         case S4BXI_E2E_ACK:
-            reliable_comm(msg);
+            reliable_comm<Policy>(msg);
             break;
         case S4BXI_PTL_GET_RESPONSE:
             handle_get_response(msg);
@@ -83,9 +77,9 @@ void BxiNicInitiator::operator()()
     }
 }
 
-void BxiNicInitiator::handle_put(BxiMsg* msg)
+template <typename Policy> void BxiNicInitiator<Policy>::handle_put(BxiMsg* msg)
 {
-    s4u::CommPtr dma = nullptr;
+    bxi_pci_transfer dma;
 
     auto req = (BxiPutRequest*)msg->parent_request;
     req->md->ni->cq->release();
@@ -93,35 +87,34 @@ void BxiNicInitiator::handle_put(BxiMsg* msg)
     int inline_size = INLINE_SIZE(req);
     int PIO_size    = PIO_SIZE(req);
 
-    int _bxi_log_level = S4BXI_GLOBAL_CONFIG(log_level);
-    if (_bxi_log_level) {
-        msg->bxi_log       = make_shared<BxiLog>();
-        msg->bxi_log->type = (bxi_log_type)msg->type; // Highly unsafe cast, see comment in BxiNicActor::reliable_comm
+    // Highly unsafe cast, see comment in BxiNicActor::reliable_comm
+    auto log_type = (bxi_log_type)msg->type;
+    if (S4BXI_POLICY_LOG_LEVEL(Policy) && BxiEngine::must_log(log_type, msg->initiator, msg->target)) {
+        msg->bxi_log            = make_shared<BxiLog>();
+        msg->bxi_log->type      = log_type;
         msg->bxi_log->initiator = msg->initiator;
         msg->bxi_log->target    = msg->target;
+        msg->bxi_log->size      = msg->simulated_size;
     }
-    s4u::CommPtr comm = reliable_comm_init(msg, false);
+    s4u::CommPtr comm = reliable_comm_init<Policy>(msg, false);
 
-    if (!msg->is_PIO && S4BXI_CONFIG_AND(node, model_pci) &&
+    if (!msg->is_PIO && S4BXI_POLICY_AND(Policy, node, model_pci) &&
         (msg->retry_count && msg->simulated_size > 64 // Retransmissions are always DMA (except small ones)
          || (!msg->retry_count && msg->simulated_size > inline_size))) {
         // Ask for the memory we need to send (DMA case)
 
-        // Actually there are (msg->simulated_size / DMA chunk size) requests in real life,
-        // and I don't know if they weigh 64B or something else. (chunk size is 128, 256,
-        // 512 or 1024B)
-        node->pci_transfer(64, PCI_NIC_TO_CPU, S4BXILOG_PCI_DMA_REQUEST);
+        // There are (payload size / MRRS) read requests, the PCI model gives their size
+        node->pci_transfer(req->payload_size - inline_size, PCI_NIC_TO_CPU, S4BXILOG_PCI_DMA_REQUEST);
         // S4BXI_STARTLOG(S4BXILOG_PCI_DMA_PAYLOAD, node->nid, node->nid)
         dma = node->pci_transfer_async(req->payload_size - inline_size, PCI_CPU_TO_NIC, S4BXILOG_PCI_DMA_PAYLOAD);
         // Wait for first packet (very approximate heuristic)
-        double wait_time = msg->simulated_size >= 512 ? ONE_PCI_PACKET_TRANSFER
-                                                      : (PCI_LATENCY + ((double)msg->simulated_size) / 15.75e9);
+        double wait_time = node->pci->first_packet_time(msg->simulated_size);
         s4u::this_actor::sleep_for(wait_time);
 
-        if (_bxi_log_level)
+        if (msg->bxi_log)
             msg->bxi_log->start = s4u::Engine::get_clock();
     } else {
-        if (_bxi_log_level)
+        if (msg->bxi_log)
             msg->bxi_log->start = s4u::Engine::get_clock();
     }
 
@@ -130,12 +123,12 @@ void BxiNicInitiator::handle_put(BxiMsg* msg)
     if (dma) {
         // Important note (because of the next "if"): this branch can't happen for messages <= 64 B unless it's a
         // retransmission
-        dma->wait();
+        dma.wait();
         // double wait = (req->payload_size - inline_size) / 11.1e9 - 300e-9;
         // if (wait > 1e-9)
         //     s4u::this_actor::sleep_for(wait);
     } else {
-        s4u::this_actor::sleep_for(200e-9);
+        s4u::this_actor::sleep_for(node->pci->latency);
     }
 
     // Buffered put
@@ -144,62 +137,65 @@ void BxiNicInitiator::handle_put(BxiMsg* msg)
     }
 }
 
-void BxiNicInitiator::handle_get(BxiMsg* msg)
+template <typename Policy> void BxiNicInitiator<Policy>::handle_get(BxiMsg* msg)
 {
     ((BxiGetRequest*)msg->parent_request)->md->ni->cq->release();
-    reliable_comm(msg);
+    reliable_comm<Policy>(msg);
 
-    s4u::this_actor::sleep_for(250e-9); // Blocking time, models the request's processing in the NIC
+    // Blocking time, models the request's processing in the NIC
+    s4u::this_actor::sleep_for(node->pci->latency + NIC_GET_PROCESSING);
 }
 
-void BxiNicInitiator::handle_response(BxiMsg* msg, bxi_log_type type)
+template <typename Policy> void BxiNicInitiator<Policy>::handle_response(BxiMsg* msg, bxi_log_type type)
 {
-    s4u::CommPtr dma = nullptr;
+    bxi_pci_transfer dma;
 
-    int _bxi_log_level = S4BXI_GLOBAL_CONFIG(log_level);
-    if (_bxi_log_level) {
+    if (S4BXI_POLICY_LOG_LEVEL(Policy) && BxiEngine::must_log(type, msg->initiator, msg->target)) {
         msg->bxi_log            = make_shared<BxiLog>();
         msg->bxi_log->type      = type;
         msg->bxi_log->initiator = msg->initiator;
         msg->bxi_log->target    = msg->target;
+        msg->bxi_log->size      = msg->simulated_size;
     }
-    s4u::CommPtr comm = reliable_comm_init(msg, false);
+    s4u::CommPtr comm = reliable_comm_init<Policy>(msg, false);
 
-    if (S4BXI_CONFIG_AND(node, model_pci) && msg->simulated_size) {
+    if (S4BXI_POLICY_AND(Policy, node, model_pci) && msg->simulated_size) {
         // Ask for the memory we need to send (Get is always DMA)
-        node->pci_transfer(64, PCI_NIC_TO_CPU, S4BXILOG_PCI_DMA_REQUEST);
+        node->pci_transfer(msg->simulated_size, PCI_NIC_TO_CPU, S4BXILOG_PCI_DMA_REQUEST);
         dma = node->pci_transfer_async(msg->simulated_size, PCI_CPU_TO_NIC, S4BXILOG_PCI_DMA_PAYLOAD);
         // Wait for first packet (very approximate heuristic)
-        double wait_time = msg->simulated_size >= 512 ? ONE_PCI_PACKET_TRANSFER
-                                                      : (PCI_LATENCY + ((double)msg->simulated_size) / 15.75e9);
+        double wait_time = node->pci->first_packet_time(msg->simulated_size);
         s4u::this_actor::sleep_for(wait_time);
 
-        if (_bxi_log_level)
+        if (msg->bxi_log)
             msg->bxi_log->start = s4u::Engine::get_clock();
     } else {
-        if (_bxi_log_level)
+        if (msg->bxi_log)
             msg->bxi_log->start = s4u::Engine::get_clock();
     }
     comm->detach(); // Starts the comm
 
     if (dma)
-        dma->wait();
+        dma.wait();
     else
-        s4u::this_actor::sleep_for(300e-9);
+        s4u::this_actor::sleep_for(node->pci->latency + NIC_RESPONSE_PROCESSING);
 }
 
-void BxiNicInitiator::handle_get_response(BxiMsg* msg)
+template <typename Policy> void BxiNicInitiator<Policy>::handle_get_response(BxiMsg* msg)
 {
     handle_response(msg, S4BXILOG_PTL_GET_RESPONSE);
 
-    if (node->e2e_off) // If E2E is off we will never get an E2E ACK, so do this here I guess
+    if (!Policy::e2e || node->e2e_off) // If E2E is off we will never get an E2E ACK, so do this here I guess
         maybe_issue_get((BxiGetRequest*)msg->parent_request);
 }
 
-void BxiNicInitiator::handle_fetch_atomic_response(BxiMsg* msg)
+template <typename Policy> void BxiNicInitiator<Policy>::handle_fetch_atomic_response(BxiMsg* msg)
 {
     handle_response(msg, S4BXILOG_PTL_FETCH_ATOMIC_RESPONSE);
 
-    if (node->e2e_off) // If E2E is off we will never get an E2E ACK, so do this here I guess
+    if (!Policy::e2e || node->e2e_off) // If E2E is off we will never get an E2E ACK, so do this here I guess
         maybe_issue_fetch_atomic((BxiFetchAtomicRequest*)msg->parent_request);
 }
+
+template class BxiNicInitiator<BxiFullNicPolicy>;
+template class BxiNicInitiator<BxiFastNicPolicy>;
@@ -15,6 +15,7 @@
  */
 
 #include "s4bxi/actors/BxiNicTarget.hpp"
+#include "s4bxi/actors/BxiNicE2E.hpp"
 
 #include <xbt.h>
 #include <complex.h>
@@ -25,10 +26,34 @@ using namespace simgrid;
 
 S4BXI_LOG_NEW_DEFAULT_CATEGORY(s4bxi_nic_target, "Messages specific to the NIC target");
 
-BxiNicTarget::BxiNicTarget(const vector<string>& args) : BxiNicActor(args)
+template <typename Policy>
+BxiNicTarget<Policy>::BxiNicTarget(const vector<string>& args, bool delivers_analytic_acks) : BxiNicActor(args)
 {
-    nic_rx_mailbox = s4u::Mailbox::by_name(nic_rx_mailbox_name(vn));
+    if (delivers_analytic_acks) {
+        ack_queue = node->ack_queues[vn];
+        s4u::this_actor::on_exit([this](bool) { ack_queue->clear(); });
+        return;
+    }
+
+    nic_rx_mailbox = node->get_nic_rx_mailbox(node->nid, vn);
     nic_rx_mailbox->set_receiver(self);
+
+    // Shared by the targets of all VNs
+    if (Policy::e2e && BxiLossModel::enabled() && !node->loss_model)
+        node->loss_model = make_unique<BxiLossModel>(node->nid);
+
+    // ACKs only travel on response VNs
+    if (S4BXI_GLOBAL_CONFIG(analytic_acks) && !S4BXI_GLOBAL_CONFIG(quick_acks) &&
+        (vn == S4BXI_VN_SERVICE_RESPONSE || vn == S4BXI_VN_COMPUTE_RESPONSE)) {
+        node->ack_queues[vn] = make_shared<BxiAckQueue>();
+
+        auto twin = s4u::Actor::init("nic_analytic_acks", self->get_host());
+        twin->set_property("VN", to_string(vn));
+        twin->start([args]() {
+            BxiNicTarget<Policy> actor(args, true);
+            actor();
+        });
+    }
 }
 
 /**
@@ -36,7 +61,7 @@ BxiNicTarget::BxiNicTarget(const vector<string>& args) : BxiNicActor(args)
  *
  * It is OK to have an infinite loop since this actor is daemonized
  */
-void BxiNicTarget::operator()()
+template <typename Policy> void BxiNicTarget<Policy>::operator()()
 {
     // TX VN is always RESPONSE, we just need to determine SERVICE / COMPUTE
     bxi_vn tx_vn = (vn == S4BXI_VN_SERVICE_REQUEST || vn == S4BXI_VN_SERVICE_RESPONSE) ? S4BXI_VN_SERVICE_RESPONSE
@@ -48,10 +73,23 @@ void BxiNicTarget::operator()()
 
     for (;;) {
         BxiMsg* msg;
-        nic_rx_mailbox->get_init()
-            ->set_dst_data(reinterpret_cast<void**>(&msg), sizeof(void*))
-            ->set_copy_data_callback(&s4u::Comm::copy_pointer_callback)
-            ->wait();
+        if (ack_queue) {
+            msg = ack_queue->get(); // Analytic ACKs can't be lost, see send_analytic_ack
+        } else {
+            nic_rx_mailbox->get_init()
+                ->set_dst_data(reinterpret_cast<void**>(&msg), sizeof(void*))
+                ->set_copy_data_callback(&s4u::Comm::copy_pointer_callback)
+                ->wait();
+        }
+
+        if (!ack_queue && Policy::e2e && node->loss_model) {
+            if (node->loss_model->drop(msg)) { // Lost on the wire, E2E will retransmit it
+                BxiMsg::unref(msg);
+                continue;
+            }
+            if (msg->retry_count)
+                node->loss_model->record_delivery(msg);
+        }
 
         if (msg->bxi_log) {
             msg->bxi_log->end = s4u::Engine::get_clock();
@@ -88,7 +126,7 @@ void BxiNicTarget::operator()()
     }
 }
 
-void BxiNicTarget::send_ack(BxiMsg* msg, bxi_msg_type ack_type, int ni_fail_type)
+template <typename Policy> void BxiNicTarget<Policy>::send_ack(BxiMsg* msg, bxi_msg_type ack_type, int ni_fail_type)
 {
     auto req = (BxiPutRequest*)msg->parent_request;
 
@@ -119,8 +157,69 @@ void BxiNicTarget::send_ack(BxiMsg* msg, bxi_msg_type ack_type, int ni_fail_type
         ack->ni_fail_type   = ni_fail_type;
         ack->answers_msg    = msg;
         ++msg->ref_count;
+        put_ack(ack);
+    }
+}
+
+/**
+ * Send an ACK (Portals or E2E) to its initiator, analytically if possible
+ */
+template <typename Policy> void BxiNicTarget<Policy>::put_ack(BxiMsg* ack)
+{
+    if (!send_analytic_ack(ack))
         tx_queue->put(ack, 0, true);
+}
+
+/**
+ * Deliver an ACK at its initiator after the time it would take to cross the network if the route
+ * was free, without simulating any comm nor going through our NIC initiator. This is only accurate
+ * on uncongested paths, so we don't do it if our TX queue has a backlog, if the initiator still
+ * has messages to receive on this VN or if another flow is using the route
+ *
+ * Analytic ACKs can't be lost, so they are not followed by E2E (and Portals ACKs aren't
+ * acknowledged in turn by an E2E ACK). If we're injecting losses, Portals ACKs always go through
+ * the network so that they can be lost, but E2E ACKs are never lost anyway
+ *
+ * @return false if the ACK must be sent through the network
+ */
+template <typename Policy> bool BxiNicTarget<Policy>::send_analytic_ack(BxiMsg* ack)
+{
+    if (!S4BXI_GLOBAL_CONFIG(analytic_acks))
+        return false;
+
+    bxi_vn ack_vn = ack->get_vn();
+    auto& queue   = BxiEngine::get_instance()->get_node(ack->target)->ack_queues[ack_vn];
+    if (!queue || (ack->type == S4BXI_PTL_ACK && BxiLossModel::enabled()) || tx_queue->size() ||
+        node->get_nic_rx_mailbox(ack->target, ack_vn)->listen()) {
+        ++node->fallback_acks;
+        return false;
+    }
+
+    const nic_route& route = node->get_nic_route(ack->target);
+    for (auto link : route.links) {
+        if (link->get_load() > 0) {
+            ++node->fallback_acks;
+            return false;
+        }
     }
+
+    double now = s4u::Engine::get_clock();
+    // Highly unsafe cast, see comment in BxiNicActor::reliable_comm
+    auto log_type = (bxi_log_type)ack->type;
+    if (S4BXI_POLICY_LOG_LEVEL(Policy) && BxiEngine::must_log(log_type, ack->initiator, ack->target)) {
+        ack->bxi_log            = make_shared<BxiLog>();
+        ack->bxi_log->type      = log_type;
+        ack->bxi_log->initiator = ack->initiator;
+        ack->bxi_log->target    = ack->target;
+        ack->bxi_log->size      = ack->simulated_size;
+        ack->bxi_log->start     = now;
+    }
+
+    ack->analytic = true;
+    queue->put(ack, now + route.latency + ack->simulated_size / route.bandwidth);
+    ++node->analytic_acks;
+
+    return true;
 }
 
 /**
@@ -131,7 +230,7 @@ void BxiNicTarget::send_ack(BxiMsg* msg, bxi_msg_type ack_type, int ni_fail_type
  * When checking options, we don't need to differentiate ME / LE case :
  * each PTL_LE_XXXXX is defined as an alias for PTL_ME_XXXXX (see portals4.h)
  */
-void BxiNicTarget::handle_put_request(BxiMsg* msg)
+template <typename Policy> void BxiNicTarget<Policy>::handle_put_request(BxiMsg* msg)
 {
     auto req = (BxiPutRequest*)msg->parent_request;
 
@@ -158,9 +257,9 @@ void BxiNicTarget::handle_put_request(BxiMsg* msg)
 
         req->mlength = me->get_mlength(req);
 
-        shared_ptr<BxiMD> md = req->md;
+        BxiMD* md = req->md;
         req->start           = me->get_offsetted_addr(msg, true);
-        if (S4BXI_CONFIG_AND(node, use_real_memory) && md->md.length)
+        if (S4BXI_POLICY_AND(Policy, node, use_real_memory) && md->md.length)
             // Here we could copy only the pointer if this piece of memory is read but not written
             capped_memcpy(req->start, (unsigned char*)md->md.start + req->local_offset, req->mlength);
 
@@ -168,7 +267,7 @@ void BxiNicTarget::handle_put_request(BxiMsg* msg)
             me->increment_ct(req->payload_size);
 
         bool need_portals_ack = !HAS_PTL_OPTION(me->me, PTL_ME_ACK_DISABLE) && req->ack_req != PTL_NO_ACK_REQ;
-        need_ack              = need_portals_ack || !S4BXI_CONFIG_OR(md->ni->node, e2e_off);
+        need_ack              = need_portals_ack || S4BXI_POLICY_E2E_ON(Policy, md->ni->node);
         ack_type              = need_portals_ack ? S4BXI_PTL_ACK : S4BXI_E2E_ACK;
 
         me->in_use = false;
@@ -184,8 +283,8 @@ void BxiNicTarget::handle_put_request(BxiMsg* msg)
         send_ack(msg, ack_type, ni_fail_type);
 
     // Simulate the PCI transfer to write data to memory (thanks frs69wq for the idea)
-    if (matched_me && S4BXI_CONFIG_AND(node, model_pci) && msg->simulated_size) {
-        int __bxi_log_level = S4BXI_GLOBAL_CONFIG(log_level);
+    if (matched_me && S4BXI_POLICY_AND(Policy, node, model_pci) && msg->simulated_size) {
+        int __bxi_log_level = S4BXI_POLICY_LOG_LEVEL(Policy);
         if (__bxi_log_level) {
             __bxi_log.start     = simgrid::s4u::Engine::get_clock();
             __bxi_log.type      = S4BXILOG_PCI_PAYLOAD_WRITE;
@@ -194,8 +293,7 @@ void BxiNicTarget::handle_put_request(BxiMsg* msg)
         }
 
         // Wait for last PCI packet write (very approximate heuristic)
-        double wait_time = msg->simulated_size >= 512 ? ONE_PCI_PACKET_TRANSFER
-                                                      : (PCI_LATENCY + ((double)msg->simulated_size) / 15.75e9);
+        double wait_time = node->pci->first_packet_time(msg->simulated_size);
         s4u::this_actor::sleep_for(wait_time);
         node->pci_transfer(msg->simulated_size, PCI_NIC_TO_CPU, S4BXILOG_PCI_PAYLOAD_WRITE);
     }
@@ -209,7 +307,7 @@ void BxiNicTarget::handle_put_request(BxiMsg* msg)
  * When checking options, we don't need to differentiate ME / LE case :
  * each PTL_LE_XXXXX is defined as an alias for PTL_ME_XXXXX (see portals4.h)
  */
-void BxiNicTarget::handle_get_request(BxiMsg* msg)
+template <typename Policy> void BxiNicTarget<Policy>::handle_get_request(BxiMsg* msg)
 {
     auto req = (BxiGetRequest*)msg->parent_request;
 
@@ -223,6 +321,8 @@ void BxiNicTarget::handle_get_request(BxiMsg* msg)
     response->target       = msg->initiator;
     response->retry_count  = 0;
     response->ni_fail_type = match_entry(msg, &me);
+    response->answers_msg  = msg; // So that the initiator can cancel the E2E timer of the request
+    ++msg->ref_count;
 
     if (me) {
         me->in_use         = true;
@@ -236,7 +336,7 @@ void BxiNicTarget::handle_get_request(BxiMsg* msg)
 
         response->simulated_size = req->mlength;
 
-        if (S4BXI_CONFIG_AND(req->md->ni->node, use_real_memory) && me->me->length)
+        if (S4BXI_POLICY_AND(Policy, req->md->ni->node, use_real_memory) && me->me->length)
             capped_memcpy((unsigned char*)req->md->md.start + req->local_offset, req->start, req->mlength);
 
         me->in_use = false;
@@ -255,19 +355,19 @@ void BxiNicTarget::handle_get_request(BxiMsg* msg)
  *
  * Very similar to Put processing, should probably be factorized
  */
-void BxiNicTarget::handle_atomic_request(BxiMsg* msg)
+template <typename Policy> void BxiNicTarget<Policy>::handle_atomic_request(BxiMsg* msg)
 {
-    s4u::CommPtr dma = nullptr;
+    bxi_pci_transfer dma;
 
     auto req = (BxiAtomicRequest*)msg->parent_request;
 
     if (req->process_state > S4BXI_REQ_CREATED)
         return; // Don't process the same message twice
 
-    shared_ptr<BxiMD> md = req->md;
+    BxiMD* md = req->md;
 
     bool need_portals_ack = req->ack_req != PTL_NO_ACK_REQ;
-    bool need_ack         = need_portals_ack || !S4BXI_CONFIG_OR(md->ni->node, e2e_off);
+    bool need_ack         = need_portals_ack || S4BXI_POLICY_E2E_ON(Policy, md->ni->node);
     bxi_msg_type ack_type = need_portals_ack ? S4BXI_PTL_ACK : S4BXI_E2E_ACK;
 
     BxiME* me        = nullptr;
@@ -286,7 +386,7 @@ void BxiNicTarget::handle_atomic_request(BxiMsg* msg)
         req->mlength       = me->get_mlength(req);
 
         req->start = me->get_offsetted_addr(msg, true);
-        if (S4BXI_CONFIG_AND(node, use_real_memory) && md->md.length)
+        if (S4BXI_POLICY_AND(Policy, node, use_real_memory) && md->md.length)
             apply_atomic_op(req->op, req->datatype, (unsigned char*)req->start,
                             (unsigned char*)md->md.start + req->local_offset,
                             (unsigned char*)md->md.start + req->local_offset,
@@ -298,12 +398,12 @@ void BxiNicTarget::handle_atomic_request(BxiMsg* msg)
         // Update portals ack status based on ME
         need_portals_ack = need_portals_ack && !HAS_PTL_OPTION(me->me, PTL_ME_ACK_DISABLE);
         // Refresh need_ack and ack_type based on portals ack status
-        need_ack = need_portals_ack || !S4BXI_CONFIG_OR(md->ni->node, e2e_off);
+        need_ack = need_portals_ack || S4BXI_POLICY_E2E_ON(Policy, md->ni->node);
         ack_type = need_portals_ack ? S4BXI_PTL_ACK : S4BXI_E2E_ACK;
 
         // Simulate the PCI transfer to write data to memory (thanks frs69wq for the idea)
-        if (S4BXI_CONFIG_AND(node, model_pci) && msg->simulated_size) {
-            int __bxi_log_level = S4BXI_GLOBAL_CONFIG(log_level);
+        if (S4BXI_POLICY_AND(Policy, node, model_pci) && msg->simulated_size) {
+            int __bxi_log_level = S4BXI_POLICY_LOG_LEVEL(Policy);
             if (__bxi_log_level) {
                 __bxi_log.start     = simgrid::s4u::Engine::get_clock();
                 __bxi_log.type      = S4BXILOG_PCI_PAYLOAD_WRITE;
@@ -313,8 +413,7 @@ void BxiNicTarget::handle_atomic_request(BxiMsg* msg)
 
             dma = node->pci_transfer_async(msg->simulated_size, PCI_NIC_TO_CPU, S4BXILOG_PCI_PAYLOAD_WRITE);
             // Wait for last PCI packet write (very approximate heuristic)
-            double wait_time = msg->simulated_size >= 512 ? ONE_PCI_PACKET_TRANSFER
-                                                          : (PCI_LATENCY + ((double)msg->simulated_size) / 15.75e9);
+            double wait_time = node->pci->first_packet_time(msg->simulated_size);
             s4u::this_actor::sleep_for(wait_time);
         }
 
@@ -327,7 +426,7 @@ void BxiNicTarget::handle_atomic_request(BxiMsg* msg)
     }
 
     if (dma)
-        dma->wait();
+        dma.wait();
 }
 
 /**
@@ -340,7 +439,7 @@ void BxiNicTarget::handle_atomic_request(BxiMsg* msg)
  * It's also here that we handle SWAP operations, since they are just
  * a special case of fetch atomic (according to Portals spec)
  */
-void BxiNicTarget::handle_fetch_atomic_request(BxiMsg* msg)
+template <typename Policy> void BxiNicTarget<Policy>::handle_fetch_atomic_request(BxiMsg* msg)
 {
     auto req = (BxiFetchAtomicRequest*)msg->parent_request;
 
@@ -354,21 +453,23 @@ void BxiNicTarget::handle_fetch_atomic_request(BxiMsg* msg)
     response->target       = msg->initiator;
     response->retry_count  = 0;
     response->ni_fail_type = match_entry(msg, &me);
+    response->answers_msg  = msg; // So that the initiator can cancel the E2E timer of the request
+    ++msg->ref_count;
 
     if (me) {
         me->in_use         = true;
         req->process_state = S4BXI_REQ_RECEIVED;
 
-        shared_ptr<BxiMD> md = req->md;
+        BxiMD* md = req->md;
         req->matched_me      = make_unique<BxiME>(*me);
         req->mlength         = me->get_mlength(req);
         req->start           = me->get_offsetted_addr(msg, true);
-        if (S4BXI_CONFIG_AND(node, use_real_memory) && md->md.length) {
+        if (S4BXI_POLICY_AND(Policy, node, use_real_memory) && md->md.length) {
             if (me->me->length)
                 capped_memcpy((unsigned char*)req->get_md->md.start + req->get_local_offset, req->start, req->mlength);
 
             unsigned char* cst = req->is_swap_request()
-                                     ? (unsigned char*)&((BxiSwapRequest*)req)->cst
+                                     ? (unsigned char*)((BxiSwapRequest*)req)->cst
                                      : (unsigned char*)md->md.start + req->local_offset; // Whatever, won't be used
 
             apply_atomic_op(
@@ -395,15 +496,17 @@ void BxiNicTarget::handle_fetch_atomic_request(BxiMsg* msg)
     tx_queue->put(response, 0, true);
 }
 
-void BxiNicTarget::handle_response(BxiMsg* msg)
+template <typename Policy> void BxiNicTarget<Policy>::handle_response(BxiMsg* msg)
 {
-    s4u::CommPtr dma = nullptr;
+    bxi_pci_transfer dma;
 
     BxiRequest* req = msg->parent_request;
-    shared_ptr<BxiMD> md =
+    BxiMD* md =
         req->type == S4BXI_FETCH_ATOMIC_REQUEST ? ((BxiFetchAtomicRequest*)msg->parent_request)->get_md : req->md;
     node->release_e2e_entry(msg->initiator, req->service_vn ? S4BXI_VN_SERVICE_REQUEST : S4BXI_VN_COMPUTE_REQUEST,
                             req->md->ni->pid, req->target_pid);
+    // The request will be at least ANSWERED when we return
+    cancel_e2e(msg->answers_msg);
 
     if (req->process_state > S4BXI_REQ_RECEIVED)
         return;
@@ -416,8 +519,8 @@ void BxiNicTarget::handle_response(BxiMsg* msg)
     // s4u::this_actor::execute(300); // Approximation of the time it takes the NIC to process a message
 
     // Simulate the PCI transfer to write data to memory
-    if (S4BXI_CONFIG_AND(node, model_pci) && msg->simulated_size) {
-        int __bxi_log_level = S4BXI_GLOBAL_CONFIG(log_level);
+    if (S4BXI_POLICY_AND(Policy, node, model_pci) && msg->simulated_size) {
+        int __bxi_log_level = S4BXI_POLICY_LOG_LEVEL(Policy);
         if (__bxi_log_level) {
             __bxi_log.start     = simgrid::s4u::Engine::get_clock();
             __bxi_log.type      = S4BXILOG_PCI_PAYLOAD_WRITE;
@@ -427,12 +530,11 @@ void BxiNicTarget::handle_response(BxiMsg* msg)
 
         dma = node->pci_transfer_async(msg->simulated_size, PCI_NIC_TO_CPU, S4BXILOG_PCI_PAYLOAD_WRITE);
         // Wait for last PCI packet write (very approximate heuristic)
-        double wait_time = msg->simulated_size >= 512 ? ONE_PCI_PACKET_TRANSFER
-                                                      : (PCI_LATENCY + ((double)msg->simulated_size) / 15.75e9);
+        double wait_time = node->pci->first_packet_time(msg->simulated_size);
         s4u::this_actor::sleep_for(wait_time);
     }
 
-    if (!S4BXI_CONFIG_OR(md->ni->node, e2e_off)) {
+    if (S4BXI_POLICY_E2E_ON(Policy, md->ni->node)) {
         auto bxi_ack            = new BxiMsg(*msg);
         bxi_ack->type           = S4BXI_E2E_ACK;
         bxi_ack->initiator      = msg->target;
@@ -440,31 +542,34 @@ void BxiNicTarget::handle_response(BxiMsg* msg)
         bxi_ack->simulated_size = ACK_SIZE;
         bxi_ack->answers_msg    = msg;
         ++msg->ref_count;
-        tx_queue->put(bxi_ack, 0, true);
+        put_ack(bxi_ack);
     }
 
+    req->end_md_use(); // REPLY is the last event of Gets and Fetch Atomics
+
     if (HAS_PTL_OPTION(&md->md, PTL_MD_EVENT_CT_REPLY))
         md->increment_ct(req->payload_size);
 
-    auto reply_evt           = new ptl_event_t;
-    reply_evt->type          = PTL_EVENT_REPLY;
-    reply_evt->ni_fail_type  = msg->ni_fail_type;
-    reply_evt->user_ptr      = req->user_ptr;
-    reply_evt->mlength       = req->mlength;
-    reply_evt->remote_offset = req->target_remote_offset;
-    node->issue_event((BxiEQ*)md->md.eq_handle, reply_evt);
+    ptl_event_t reply_evt;
+    reply_evt.type          = PTL_EVENT_REPLY;
+    reply_evt.ni_fail_type  = msg->ni_fail_type;
+    reply_evt.user_ptr      = req->user_ptr;
+    reply_evt.mlength       = req->mlength;
+    reply_evt.remote_offset = req->target_remote_offset;
+    node->issue_event((BxiEQ*)md->md.eq_handle, &reply_evt);
 
     if (dma)
-        dma->wait();
+        dma.wait();
 }
 
-void BxiNicTarget::handle_ptl_ack(BxiMsg* msg)
+template <typename Policy> void BxiNicTarget<Policy>::handle_ptl_ack(BxiMsg* msg)
 {
     auto req = (BxiPutRequest*)msg->parent_request;
     node->release_e2e_entry(msg->initiator, req->service_vn ? S4BXI_VN_SERVICE_REQUEST : S4BXI_VN_COMPUTE_REQUEST,
                             req->md->ni->pid, req->target_pid);
 
-    if (!S4BXI_CONFIG_OR(req->md->ni->node, e2e_off)) {
+    // Analytic ACKs aren't followed by the E2E of the target, so they don't need to be acknowledged
+    if (S4BXI_POLICY_E2E_ON(Policy, req->md->ni->node) && !msg->analytic) {
         auto bxi_ack            = new BxiMsg(*msg);
         bxi_ack->type           = S4BXI_E2E_ACK;
         bxi_ack->initiator      = msg->target;
@@ -472,7 +577,7 @@ void BxiNicTarget::handle_ptl_ack(BxiMsg* msg)
         bxi_ack->simulated_size = ACK_SIZE;
         bxi_ack->answers_msg    = msg;
         ++msg->ref_count;
-        tx_queue->put(bxi_ack, 0, true);
+        put_ack(bxi_ack);
     }
 
     if (req->process_state <= S4BXI_REQ_RECEIVED) {
@@ -482,6 +587,8 @@ void BxiNicTarget::handle_ptl_ack(BxiMsg* msg)
 
         req->issue_ack(msg->ni_fail_type);
     }
+
+    cancel_e2e(msg->answers_msg);
 }
 
 /**
@@ -492,18 +599,19 @@ void BxiNicTarget::handle_ptl_ack(BxiMsg* msg)
  *
  * @param msg Incoming BXI ACK
  */
-void BxiNicTarget::handle_bxi_ack(BxiMsg* msg)
+template <typename Policy> void BxiNicTarget<Policy>::handle_bxi_ack(BxiMsg* msg)
 {
     auto req = msg->parent_request;
 
+    if (!msg->answers_msg)
+        ptl_panic("E2E ACK without an `answer_msg`");
+    cancel_e2e(msg->answers_msg);
+
     if (req->process_state >= S4BXI_REQ_FINISHED)
         return;
 
     req->process_state = S4BXI_REQ_FINISHED;
 
-    if (!msg->answers_msg)
-        ptl_panic("E2E ACK without an `answer_msg`");
-
     bxi_vn vn            = msg->answers_msg->get_vn();
     bool answers_request = vn == S4BXI_VN_COMPUTE_REQUEST || vn == S4BXI_VN_SERVICE_REQUEST;
     ptl_pid_t s_pid      = answers_request ? req->md->ni->pid : req->target_pid;
@@ -533,19 +641,36 @@ void BxiNicTarget::handle_bxi_ack(BxiMsg* msg)
  * @param me Output ME if matching succeeded
  * @return Portals' NI status code
  */
-int BxiNicTarget::match_entry(BxiMsg* msg, BxiME** me)
+template <typename Policy> int BxiNicTarget<Policy>::match_entry(BxiMsg* msg, BxiME** me)
 {
     auto req = msg->parent_request;
+
+    // PIDs are unique on a node, so unless the initiator targets PTL_PID_ANY there is only one candidate
+    if (req->target_pid != PTL_PID_ANY) {
+        auto ni = node->get_ni(req->target_pid);
+        if (!ni || !ni->can_match_request(req))
+            return PTL_NI_TARGET_INVALID;
+
+        // Check if the requested PT exists in the NI
+        auto pt = BxiPT::getFromNI(ni, req->pt_index);
+        if (!pt)
+            return PTL_NI_TARGET_INVALID;
+
+        if (!pt->enabled)
+            return PTL_NI_PT_DISABLED;
+
+        return (*me = pt->walk_through_lists(msg)) ? PTL_NI_OK : PTL_NI_TARGET_INVALID;
+    }
+
     for (auto ni : node->ni_handles) {
         if (!ni->can_match_request(req))
             continue; // The NI doesn't correspond, don't even look at what's inside
 
         // Check if the requested PT exists in the NI
-        if (!ni->pt_indexes.count(req->pt_index))
+        auto pt = BxiPT::getFromNI(ni, req->pt_index);
+        if (!pt)
             return PTL_NI_TARGET_INVALID;
 
-        auto pt = ni->pt_indexes[req->pt_index];
-
         if (!pt->enabled)
             return PTL_NI_PT_DISABLED;
 
@@ -556,7 +681,8 @@ int BxiNicTarget::match_entry(BxiMsg* msg, BxiME** me)
     return PTL_NI_TARGET_INVALID;
 }
 
-bool BxiNicTarget::put_like_req_ev_processing(BxiME* me, BxiMsg* msg, ptl_event_kind ev_kind)
+template <typename Policy>
+bool BxiNicTarget<Policy>::put_like_req_ev_processing(BxiME* me, BxiMsg* msg, ptl_event_kind ev_kind)
 {
     bool out = false;
     auto req = (BxiPutRequest*)msg->parent_request;
@@ -564,18 +690,18 @@ bool BxiNicTarget::put_like_req_ev_processing(BxiME* me, BxiMsg* msg, ptl_event_
     if (!HAS_PTL_OPTION(me->me, PTL_ME_EVENT_COMM_DISABLE) && !HAS_PTL_OPTION(me->me, PTL_ME_EVENT_SUCCESS_DISABLE) &&
         me->list == PTL_PRIORITY_LIST) { // OVERFLOW ME will have a PUT_OVERFLOW later
         auto eq              = me->pt->eq;
-        auto event           = new ptl_event_t;
-        event->initiator     = ptl_process_t{.phys{.nid = req->md->ni->node->nid, .pid = req->md->ni->pid}};
-        event->type          = ev_kind;
-        event->ni_fail_type  = PTL_OK;
-        event->pt_index      = me->pt->index;
-        event->user_ptr      = me->user_ptr;
-        event->hdr_data      = req->hdr;
-        event->rlength       = req->payload_size;
-        event->mlength       = req->mlength;
-        event->remote_offset = req->remote_offset;
-        event->match_bits    = req->match_bits;
-        event->start         = req->start;
+        ptl_event_t event;
+        event.initiator     = ptl_process_t{.phys{.nid = req->md->ni->node->nid, .pid = req->md->ni->pid}};
+        event.type          = ev_kind;
+        event.ni_fail_type  = PTL_OK;
+        event.pt_index      = me->pt->index;
+        event.user_ptr      = me->user_ptr;
+        event.hdr_data      = req->hdr;
+        event.rlength       = req->payload_size;
+        event.mlength       = req->mlength;
+        event.remote_offset = req->remote_offset;
+        event.match_bits    = req->match_bits;
+        event.start         = req->start;
 
         // We need to auto_unlink at this precise moment, otherwise on rare
         // occasions the ME could be already gone by the time we check if
@@ -590,7 +716,7 @@ bool BxiNicTarget::put_like_req_ev_processing(BxiME* me, BxiMsg* msg, ptl_event_
         // the "put" event, I don't know if it matters or not (I'm not
         // even sure of how the real world NIC does this)
 
-        node->issue_event(eq, event);
+        node->issue_event(eq, &event);
     } else {
         out = BxiME::maybe_auto_unlink(me);
     }
@@ -601,7 +727,7 @@ bool BxiNicTarget::put_like_req_ev_processing(BxiME* me, BxiMsg* msg, ptl_event_
 /**
  * Memcpy at most the number of bytes defined in global conf
  */
-void BxiNicTarget::capped_memcpy(void* dest, const void* src, size_t n)
+template <typename Policy> void BxiNicTarget<Policy>::capped_memcpy(void* dest, const void* src, size_t n)
 {
     long max_memcpy = S4BXI_GLOBAL_CONFIG(max_memcpy);
     size_t to_copy  = max_memcpy == -1 ? n : (max_memcpy < n ? max_memcpy : n);
@@ -623,8 +749,9 @@ void BxiNicTarget::capped_memcpy(void* dest, const void* src, size_t n)
  *
  * Imported from swptl and adapted to C++
  */
-void BxiNicTarget::apply_atomic_op(int op, int type, unsigned char* me, unsigned char* cst, unsigned char* rx,
-                                   unsigned char* tx, size_t len)
+template <typename Policy>
+void BxiNicTarget<Policy>::apply_atomic_op(int op, int type, unsigned char* me, unsigned char* cst, unsigned char* rx,
+                                           unsigned char* tx, size_t len)
 {
     int i, j, n, asize, eq, le, ge, swap;
 
@@ -1084,3 +1211,16 @@ void BxiNicTarget::apply_atomic_op(int op, int type, unsigned char* me, unsigned
         }
     }
 }
+
+/**
+ * Called when `msg` (which was sent by this NIC) got acknowledged, so that E2E doesn't
+ * have to keep it until its timeout
+ */
+template <typename Policy> void BxiNicTarget<Policy>::cancel_e2e(BxiMsg* msg)
+{
+    if (Policy::e2e && msg && node->e2e_actor)
+        node->e2e_actor->cancel(msg);
+}
+
+template class BxiNicTarget<BxiFullNicPolicy>;
+template class BxiNicTarget<BxiFastNicPolicy>;
@@ -76,8 +76,6 @@ double application_time;
 
 void* smpi_lib;
 
-map<string, uint32_t, less<>> local_ranks;
-
 static void s4bxi_copy_file(const string& src, const string& target, off_t fdin_size)
 {
     int fdin = open(src.c_str(), O_RDONLY);
@@ -168,14 +166,8 @@ void BxiUserAppActor::operator()()
 {
     map<string, string, less<>>* privatize_libs_renames = new map<string, string, less<>>;
 
-    my_rank   = stoul(string(self->get_property("rank")));
-    auto pair = local_ranks.find(getSlug());
-    if (pair == local_ranks.end()) {
-        my_local_rank = 0;
-        local_ranks.emplace(getSlug(), 0);
-    } else {
-        my_local_rank = ++pair->second;
-    }
+    my_rank       = stoul(string(self->get_property("rank")));
+    my_local_rank = BxiEngine::get_instance()->register_rank(this, my_rank);
 
     XBT_INFO("Init rank %d ; local_rank %d", my_rank, my_local_rank);
 
@@ -328,6 +320,27 @@ template <typename T> class BxiActorFactory {
     }
 };
 
+template <typename Policy> static void register_nic_actors(s4u::Engine* engine)
+{
+    engine->register_actor<BxiNicInitiator<Policy>>("nic_initiator");
+    engine->register_actor<BxiNicTarget<Policy>>("nic_target");
+}
+
+/**
+ * @return false if `func` isn't one of the NIC actors that are specialized on a policy
+ */
+template <typename Policy> static bool start_nic_actor(s4u::ActorPtr actor, const char* func, const vector<string>& args)
+{
+    if (!strcmp(func, "nic_initiator"))
+        actor->start(BxiActorFactory<BxiNicInitiator<Policy>>(args));
+    else if (!strcmp(func, "nic_target"))
+        actor->start(BxiActorFactory<BxiNicTarget<Policy>>(args));
+    else
+        return false;
+
+    return true;
+}
+
 /**
  * See segvhandler in SimGrid's EngineImpl.cpp, we're modifying it to display the current backtrace
  */
@@ -372,6 +385,7 @@ int s4bxi_default_main(int argc, char* argv[])
 #endif
 
     auto simgrid_engine = new s4u::Engine(&argc, argv);
+    BxiEngine::get_instance(); // Hydrate the configuration before anything reads it
     xbt_assert(argc > 4, "Usage: %s platform_file deployment_file user_app_path user_app_name\n", argv[0]);
 
     string platf  = argv[1];
@@ -435,16 +449,23 @@ int s4bxi_default_main(int argc, char* argv[])
     } else {
         simgrid_engine->load_platform(platf);
     }
+    BxiEngine::get_instance()->build_mailbox_tables();
 
 #ifdef BUILD_MPI_MIDDLEWARE
     simgrid_engine->set_default_comm_data_copy_callback(smpi_comm_copy_buffer_callback);
 #endif
 
+    // If nothing that the fast pipeline strips can be enabled, NIC actors don't need to check for it on each message
+    bool fast_nic = BxiFastNicPolicy::supports(BxiEngine::get_config());
+    XBT_DEBUG("Using the %s NIC pipeline", fast_nic ? "fast" : "full");
+
     /* Load deployment */
     if (!S4BXI_GLOBAL_CONFIG(use_pugixml)) {
         /* Register the classes representing the actors */
-        simgrid_engine->register_actor<BxiNicInitiator>("nic_initiator");
-        simgrid_engine->register_actor<BxiNicTarget>("nic_target");
+        if (fast_nic)
+            register_nic_actors<BxiFastNicPolicy>(simgrid_engine);
+        else
+            register_nic_actors<BxiFullNicPolicy>(simgrid_engine);
         simgrid_engine->register_actor<BxiNicE2E>("nic_e2e");
         simgrid_engine->register_actor<BxiUserAppActor>("user_app");
 
@@ -475,11 +496,12 @@ int s4bxi_default_main(int argc, char* argv[])
             for (pugi::xml_node arg : node.children("prop"))
                 actorPtr->set_property(string(arg.attribute("id").value()), string(arg.attribute("value").value()));
 
-            if (!strcmp(func, "nic_initiator"))
-                actorPtr->start(BxiActorFactory<BxiNicInitiator>(actor_args));
-            else if (!strcmp(func, "nic_target"))
-                actorPtr->start(BxiActorFactory<BxiNicTarget>(actor_args));
-            else if (!strcmp(func, "nic_e2e"))
+            bool started_nic = fast_nic ? start_nic_actor<BxiFastNicPolicy>(actorPtr, func, actor_args)
+                                        : start_nic_actor<BxiFullNicPolicy>(actorPtr, func, actor_args);
+            if (started_nic)
+                continue;
+
+            if (!strcmp(func, "nic_e2e"))
                 actorPtr->start(BxiActorFactory<BxiNicE2E>(actor_args));
             else if (!strcmp(func, "user_app")) {
                 actorPtr->start(BxiActorFactory<BxiUserAppActor>(actor_args));
@@ -0,0 +1,290 @@
+/*
+ * Author: Julien EMMANUEL
+ * Copyright (C) 2019-2022 Bull S.A.S
+ * All rights reserved
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation,
+ * which comes with this package.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+/**
+ * Microbenchmark of the matching engine (PT lists and unexpected headers), which
+ * drives BxiPT / BxiME directly instead of running a whole simulation, so that the
+ * cost of matching isn't hidden behind SimGrid's context switches.
+ *
+ * Usage: bench_matching [matches per configuration]
+ *
+ * Output is CSV on stdout, one line per configuration:
+ * - `lists`: a message is matched against `depth` posted entries (walk_through_lists),
+ *   while `uh_depth` headers that match nothing sit in the unexpected list
+ * - `uh`: an entry is appended to the priority list while `uh_depth` headers are
+ *   waiting in the unexpected list (walk_through_UHs). Match bits are random so some
+ *   appends don't find any header, which is part of what we want to measure
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <vector>
+
+#include <simgrid/s4u.hpp>
+
+#include "s4bxi/s4ptl.hpp"
+#include "s4bxi/BxiEngine.hpp"
+#include "s4bxi/BxiNode.hpp"
+
+using namespace std;
+
+static unsigned long allocations = 0;
+
+void* operator new(size_t size)
+{
+    ++allocations;
+    if (void* p = malloc(size ? size : 1))
+        return p;
+    throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+// Never posted in the priority list, used for headers that should stay unexpected
+#define UNMATCHED_BITS (1ULL << 40)
+// Wildcards accept a whole group of match bits
+#define WILDCARD_IGNORE 0xFULL
+
+struct bench_config {
+    int depth;
+    double wildcard_fraction;
+    int uh_depth;
+    bool use_once;
+};
+
+struct bench_result {
+    double ns_per_match;
+    double allocs_per_match;
+};
+
+class MatchingBench {
+    shared_ptr<BxiNode> node;
+    BxiNI* ni;
+    BxiMD* md;
+    BxiPT* pt;
+    ptl_pt_index_t pt_index;
+    mt19937_64 rng;
+
+    ptl_me_t make_me(ptl_match_bits_t match_bits, bool wildcard, bool use_once) const
+    {
+        ptl_me_t me    = {};
+        me.length      = 1 << 20;
+        me.ct_handle   = PTL_CT_NONE;
+        me.uid         = PTL_UID_ANY;
+        me.match_bits  = wildcard ? (match_bits & ~WILDCARD_IGNORE) : match_bits;
+        me.ignore_bits = wildcard ? WILDCARD_IGNORE : 0;
+        me.options     = PTL_ME_OP_PUT | PTL_ME_EVENT_LINK_DISABLE | PTL_ME_EVENT_UNLINK_DISABLE;
+        if (use_once)
+            me.options |= PTL_ME_USE_ONCE;
+
+        return me;
+    }
+
+    BxiMsg* make_msg(ptl_match_bits_t match_bits) const
+    {
+        auto req =
+            new BxiPutRequest(md, 8, true, match_bits, ni->pid, pt_index, nullptr, false, 0, 0, PTL_NO_ACK_REQ, 0);
+
+        return new BxiMsg(node->nid, node->nid, S4BXI_PTL_PUT, 8, req);
+    }
+
+    /**
+     * Same thing as the NIC target does when a message ends up in the overflow list
+     */
+    void add_unexpected(ptl_match_bits_t match_bits)
+    {
+        auto msg = make_msg(match_bits);
+        auto me  = pt->walk_through_lists(msg);
+        if (!me || me->list != PTL_OVERFLOW_LIST) {
+            fprintf(stderr, "Header 0x%lx didn't end up in the overflow list\n", match_bits);
+            exit(1);
+        }
+        msg->parent_request->matched_me = make_unique<BxiME>(*me);
+        BxiMsg::unref(msg);
+    }
+
+    bool is_wildcard()
+    {
+        return uniform_real_distribution<double>(0, 1)(rng) < current.wildcard_fraction;
+    }
+
+    void setup()
+    {
+        BxiPT::alloc(ni, 0, PTL_EQ_NONE, 0, &pt_index);
+        pt = BxiPT::getFromNI(ni, pt_index);
+
+        // Persistent catch-all overflow entry, so that every header that misses the priority list is kept
+        ptl_me_t overflow    = make_me(0, false, false);
+        overflow.ignore_bits = ~0ULL;
+        ptl_handle_me_t handle;
+        BxiME::append(pt, &overflow, PTL_OVERFLOW_LIST, nullptr, &handle);
+    }
+
+    void teardown() { BxiPT::free(ni, pt_index); }
+
+  public:
+    bench_config current;
+
+    MatchingBench() : node(make_shared<BxiNode>(0)), rng(42)
+    {
+        ptl_ni_limits_t limits = {};
+        ni                     = new BxiNI(node, 0, PTL_NI_MATCHING | PTL_NI_PHYSICAL, 0, &limits);
+        node->add_ni(ni);
+
+        ptl_md_t md_t  = {};
+        md_t.length    = 8;
+        md_t.eq_handle = PTL_EQ_NONE;
+        md_t.ct_handle = PTL_CT_NONE;
+        md             = new BxiMD(ni, &md_t);
+    }
+
+    ~MatchingBench()
+    {
+        BxiMD::release(md);
+        delete ni;
+    }
+
+    bench_result run_lists(int matches)
+    {
+        setup();
+
+        ptl_handle_me_t handle;
+        for (int i = 0; i < current.depth; ++i) {
+            auto me = make_me(i, is_wildcard(), current.use_once);
+            BxiME::append(pt, &me, PTL_PRIORITY_LIST, nullptr, &handle);
+        }
+        for (int i = 0; i < current.uh_depth; ++i)
+            add_unexpected(UNMATCHED_BITS + i);
+
+        chrono::nanoseconds elapsed(0);
+        unsigned long allocs = 0;
+
+        for (int i = 0; i < matches; ++i) {
+            auto msg = make_msg(uniform_int_distribution<int>(0, current.depth - 1)(rng));
+
+            auto start        = chrono::steady_clock::now();
+            auto start_allocs = allocations;
+
+            BxiME* me = pt->walk_through_lists(msg);
+            if (!me || me->list != PTL_PRIORITY_LIST) {
+                fprintf(stderr, "Message 0x%lx didn't match the priority list\n", msg->parent_request->match_bits);
+                exit(1);
+            }
+            ptl_me_t me_t = *me->me;
+            bool unlinked = BxiME::maybe_auto_unlink(me);
+
+            elapsed += chrono::steady_clock::now() - start;
+            allocs += allocations - start_allocs;
+
+            BxiMsg::unref(msg);
+            if (unlinked) // Keep the depth of the list constant
+                BxiME::append(pt, &me_t, PTL_PRIORITY_LIST, nullptr, &handle);
+        }
+
+        teardown();
+
+        return bench_result{(double)elapsed.count() / matches, (double)allocs / matches};
+    }
+
+    bench_result run_uh(int matches)
+    {
+        setup();
+
+        for (int i = 0; i < current.uh_depth; ++i)
+            add_unexpected(i);
+
+        chrono::nanoseconds elapsed(0);
+        unsigned long allocs = 0;
+        ptl_handle_me_t handle;
+
+        for (int i = 0; i < matches; ++i) {
+            ptl_match_bits_t bits = uniform_int_distribution<int>(0, current.uh_depth - 1)(rng);
+            auto me_t             = make_me(bits, is_wildcard(), current.use_once);
+            size_t before         = pt->unexpected_headers.size();
+
+            auto start        = chrono::steady_clock::now();
+            auto start_allocs = allocations;
+
+            BxiME::append(pt, &me_t, PTL_PRIORITY_LIST, nullptr, &handle);
+
+            elapsed += chrono::steady_clock::now() - start;
+            allocs += allocations - start_allocs;
+
+            // Entries that were linked are removed, and consumed headers are replaced, so that the
+            // priority list stays empty and the unexpected list keeps the same depth
+            size_t consumed = before - pt->unexpected_headers.size();
+            if (!current.use_once || !consumed)
+                BxiME::unlink(handle);
+            for (size_t j = 0; j < consumed; ++j)
+                add_unexpected(uniform_int_distribution<int>(0, current.uh_depth - 1)(rng));
+        }
+
+        teardown();
+
+        return bench_result{(double)elapsed.count() / matches, (double)allocs / matches};
+    }
+};
+
+int main(int argc, char* argv[])
+{
+    simgrid::s4u::Engine engine(&argc, argv);
+    BxiEngine::get_instance(); // Hydrate the configuration (indexed matching, etc.)
+
+    int matches = argc > 1 ? atoi(argv[1]) : 20000;
+
+    const vector<int> depths                = {1, 16, 256, 4096};
+    const vector<double> wildcard_fractions = {0, 0.1, 0.5, 1};
+    const vector<int> uh_depths             = {0, 64, 1024, 16384};
+
+    MatchingBench bench;
+
+    printf("scenario,depth,wildcard_fraction,uh_depth,use_once,matches,ns_per_match,allocs_per_match\n");
+
+    for (int use_once = 0; use_once < 2; ++use_once) {
+        for (auto wildcard_fraction : wildcard_fractions) {
+            for (auto depth : depths) {
+                for (auto uh_depth : uh_depths) {
+                    bench.current = bench_config{depth, wildcard_fraction, uh_depth, !!use_once};
+                    auto res      = bench.run_lists(matches);
+                    printf("lists,%d,%g,%d,%d,%d,%.1f,%.2f\n", depth, wildcard_fraction, uh_depth, use_once, matches,
+                           res.ns_per_match, res.allocs_per_match);
+                }
+            }
+
+            for (auto uh_depth : uh_depths) {
+                if (!uh_depth)
+                    continue;
+                bench.current = bench_config{0, wildcard_fraction, uh_depth, !!use_once};
+                auto res      = bench.run_uh(matches);
+                printf("uh,0,%g,%d,%d,%d,%.1f,%.2f\n", wildcard_fraction, uh_depth, use_once, matches,
+                       res.ns_per_match, res.allocs_per_match);
+            }
+        }
+    }
+
+    return 0;
+}
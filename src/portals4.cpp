@@ -200,12 +200,12 @@ int PtlMEUnlink(ptl_handle_me_t meh)
 
 int PtlMESearch(ptl_handle_ni_t nih, ptl_pt_index_t pte, const ptl_me_t* me, ptl_search_op_t op, void* arg)
 {
-    THROW_UNIMPLEMENTED;
+    BENCH_PORTALS_CALL(PtlMESearch(nih, pte, me, op, arg));
 }
 
 int PtlMESearchNB(ptl_handle_ni_t nih, ptl_pt_index_t pte, const ptl_me_t* me, ptl_search_op_t op, void* arg)
 {
-    THROW_UNIMPLEMENTED;
+    BENCH_PORTALS_CALL(PtlMESearchNB(nih, pte, me, op, arg));
 }
 
 int PtlLEAppend(ptl_handle_ni_t nih, ptl_pt_index_t pte, const struct ptl_me* me, int list, void* arg,
@@ -227,12 +227,12 @@ int PtlLEUnlink(ptl_handle_me_t meh)
 
 int PtlLESearch(ptl_handle_ni_t nih, ptl_pt_index_t pte, const ptl_me_t* me, ptl_search_op_t op, void* arg)
 {
-    THROW_UNIMPLEMENTED;
+    BENCH_PORTALS_CALL(PtlLESearch(nih, pte, me, op, arg));
 }
 
 int PtlLESearchNB(ptl_handle_ni_t nih, ptl_pt_index_t pte, const ptl_me_t* me, ptl_search_op_t op, void* arg)
 {
-    THROW_UNIMPLEMENTED;
+    BENCH_PORTALS_CALL(PtlLESearchNB(nih, pte, me, op, arg));
 }
 
 int PtlEQAllocAsync(ptl_handle_ni_t nih, ptl_size_t size, ptl_handle_eq_t* reteqh, void (*cb)(void*, ptl_handle_eq_t),
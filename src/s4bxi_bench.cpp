@@ -41,8 +41,6 @@ void s4bxi_force_execute(double duration)
 #ifdef BUILD_MPI_MIDDLEWARE
 #include <smpi/smpi.h>
 
-BxiLog __bxi_log;
-
 void s4bxi_execute(double duration)
 {
     BxiMainActor* main_actor = GET_CURRENT_MAIN_ACTOR;
@@ -56,14 +54,13 @@ void s4bxi_bench_begin()
 {
     BxiMainActor* main_actor = GET_CURRENT_MAIN_ACTOR;
 
-    ptl_nid_t nid       = GET_CURRENT_MAIN_ACTOR->getNid();
-    int __bxi_log_level = S4BXI_GLOBAL_CONFIG(log_level);
-    bool __bxi_must_log = __bxi_log_level && S4BXI_GLOBAL_CONFIG(log_computation);
-    if (__bxi_must_log) {
-        __bxi_log.start     = simgrid::s4u::Engine::get_clock();
-        __bxi_log.type      = S4BXILOG_COMPUTE;
-        __bxi_log.initiator = nid;
-        __bxi_log.target    = nid;
+    ptl_nid_t nid              = main_actor->getNid();
+    main_actor->bench_must_log = S4BXI_GLOBAL_CONFIG(log_level) && BxiEngine::must_log(S4BXILOG_COMPUTE, nid, nid);
+    if (main_actor->bench_must_log) {
+        main_actor->bench_log.start     = simgrid::s4u::Engine::get_clock();
+        main_actor->bench_log.type      = S4BXILOG_COMPUTE;
+        main_actor->bench_log.initiator = nid;
+        main_actor->bench_log.target    = nid;
     }
     smpi_bench_begin();
 }
@@ -73,11 +70,9 @@ void s4bxi_bench_end()
     BxiMainActor* main_actor = GET_CURRENT_MAIN_ACTOR;
 
     smpi_bench_end();
-    int __bxi_log_level = S4BXI_GLOBAL_CONFIG(log_level);
-    bool __bxi_must_log = __bxi_log_level && S4BXI_GLOBAL_CONFIG(log_computation);
-    if (__bxi_must_log) {
-        __bxi_log.end = simgrid::s4u::Engine::get_clock();
-        BxiEngine::get_instance()->log(__bxi_log);
+    if (main_actor->bench_must_log) {
+        main_actor->bench_log.end = simgrid::s4u::Engine::get_clock();
+        BxiEngine::get_instance()->log(main_actor->bench_log);
     }
 }
 
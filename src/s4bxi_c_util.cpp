@@ -103,28 +103,28 @@ int s4bxi_printf(const char* fmt, ...)
 
 uint32_t s4bxi_num_local_peers()
 {
-    return BxiEngine::get_instance()->main_actors_on_host(GET_CURRENT_MAIN_ACTOR->getSlug().c_str()).size() - 1;
+    return BxiEngine::get_instance()->main_actors_on_host(GET_CURRENT_MAIN_ACTOR->getSlug()).size() - 1;
 }
 
 uint32_t s4bxi_num_nodes()
 {
-    return BxiEngine::get_instance()->used_nodes().size();
+    return BxiEngine::get_instance()->get_used_node_count();
 }
 
 void s4bxi_local_peers_list(char* list, size_t maxlen)
 {
     list[0] = '\0';
-    for (auto pair : BxiEngine::get_instance()->main_actors_on_host(GET_CURRENT_MAIN_ACTOR->getSlug().c_str())) {
-        size_t cur_val_length = strlen(list);
-
-        auto ret =
-            snprintf(list + cur_val_length, maxlen - cur_val_length, "%d,", (((BxiUserAppActor*)pair.second)->my_rank));
+    size_t cur_val_length = 0;
+    for (auto actor : BxiEngine::get_instance()->main_actors_on_host(GET_CURRENT_MAIN_ACTOR->getSlug())) {
+        auto ret = snprintf(list + cur_val_length, maxlen - cur_val_length, "%d,", ((BxiUserAppActor*)actor)->my_rank);
 
         if (ret >= maxlen - cur_val_length)
             ptl_panic_fmt("Overflowing snprintf at %s:%d\n", __FILE__, __LINE__);
+        cur_val_length += ret;
     }
 
-    list[strlen(list) - 1] = '\0';
+    if (cur_val_length)
+        list[cur_val_length - 1] = '\0'; // Remove trailing comma
 }
 
 uint32_t s4bxi_get_my_rank()
@@ -206,19 +206,15 @@ void s4bxi_keyval_store_pointer(char* key, void* value)
 
 void* s4bxi_keyval_fetch_pointer(int rank, char* key)
 {
-    auto a = BxiEngine::get_instance();
-    auto b = a->get_actor_from_rank(rank);
-    auto c = b->keyval_store;
-    return c[key];
+    auto& store = BxiEngine::get_instance()->get_actor_from_rank(rank)->keyval_store;
+    auto it     = store.find(key);
+
+    return it == store.end() ? nullptr : it->second;
 }
 
-/**
- * Only allow a positive log level if there is a valid config file
- */
 void s4bxi_set_loglevel(int l)
 {
-    auto config       = BxiEngine::get_config();
-    config->log_level = config->log_folder != "/dev/null" ? l : 0;
+    BxiEngine::set_log_level(l);
 }
 
 void s4bxi_use_smpi_implem(int v)
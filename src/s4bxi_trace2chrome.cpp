@@ -0,0 +1,156 @@
+/*
+ * Author: Julien EMMANUEL
+ * Copyright (C) 2019-2022 Bull S.A.S
+ * All rights reserved
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation,
+ * which comes with this package.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+/**
+ * Convert a binary trace (written in S4BXI_LOG_FOLDER) to the Chrome trace-event
+ * JSON format, which can be opened in Perfetto (https://ui.perfetto.dev) or in
+ * chrome://tracing
+ *
+ * Usage: s4bxi-trace2chrome trace.bin [output.json]
+ *
+ * Each node is a process with four tracks: CPU, NIC TX, NIC RX and PCI. Network
+ * messages are drawn on the NIC TX track of their initiator, with a flow arrow to
+ * the NIC RX track of their target. Records are converted as they are read, so
+ * memory usage doesn't depend on the size of the trace
+ */
+
+#include <cstdio>
+#include <vector>
+
+#include "s4bxi/BxiTrace.hpp"
+
+using namespace std;
+
+#define READ_RECORDS (1 << 16)
+
+enum chrome_track { TRACK_CPU, TRACK_NIC_TX, TRACK_NIC_RX, TRACK_PCI };
+
+static const char* track_names[] = {"CPU", "NIC TX", "NIC RX", "PCI"};
+
+class ChromeWriter {
+    FILE* out;
+    bool first = true;
+    vector<bool> named_nodes;
+
+    void begin_event()
+    {
+        fputs(first ? "\n" : ",\n", out);
+        first = false;
+    }
+
+    void name_node(uint32_t nid)
+    {
+        if (nid < named_nodes.size() && named_nodes[nid])
+            return;
+        if (nid >= named_nodes.size())
+            named_nodes.resize(nid + 1);
+        named_nodes[nid] = true;
+
+        begin_event();
+        fprintf(out, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%u,\"args\":{\"name\":\"Node %u\"}}", nid, nid);
+        for (int track = TRACK_CPU; track <= TRACK_PCI; ++track) {
+            begin_event();
+            fprintf(out, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%u,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    nid, track, track_names[track]);
+        }
+    }
+
+    void slice(uint32_t nid, chrome_track track, const char* name, double start, double end,
+               const bxi_trace_record& r)
+    {
+        begin_event();
+        fprintf(out,
+                "{\"ph\":\"X\",\"name\":\"%s\",\"pid\":%u,\"tid\":%d,\"ts\":%.4f,\"dur\":%.4f,"
+                "\"args\":{\"initiator\":%u,\"target\":%u}}",
+                name, nid, track, start * 1e6, (end - start) * 1e6, r.initiator, r.target);
+    }
+
+  public:
+    explicit ChromeWriter(FILE* out) : out(out) { fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", out); }
+    ~ChromeWriter() { fputs("\n]}\n", out); }
+
+    void write(const bxi_trace_record& r, unsigned long id)
+    {
+        if (r.type >= S4BXILOG_TYPE_COUNT)
+            return;
+        const char* name = bxi_log_type_name(r.type);
+
+        name_node(r.initiator);
+        if (r.type == S4BXILOG_COMPUTE) {
+            slice(r.initiator, TRACK_CPU, name, r.start, r.end, r);
+        } else if (r.type >= S4BXILOG_PCI_PIO_PAYLOAD) {
+            slice(r.initiator, TRACK_PCI, name, r.start, r.end, r);
+        } else {
+            // Network message: on the wire from start to end, then received by the target
+            name_node(r.target);
+            slice(r.initiator, TRACK_NIC_TX, name, r.start, r.end, r);
+            slice(r.target, TRACK_NIC_RX, name, r.end, r.end, r);
+
+            begin_event();
+            fprintf(out, "{\"ph\":\"s\",\"name\":\"%s\",\"cat\":\"msg\",\"id\":%lu,\"pid\":%u,\"tid\":%d,\"ts\":%.4f}",
+                    name, id, r.initiator, TRACK_NIC_TX, r.start * 1e6);
+            begin_event();
+            fprintf(out,
+                    "{\"ph\":\"f\",\"bp\":\"e\",\"name\":\"%s\",\"cat\":\"msg\",\"id\":%lu,\"pid\":%u,\"tid\":%d,"
+                    "\"ts\":%.4f}",
+                    name, id, r.target, TRACK_NIC_RX, r.end * 1e6);
+        }
+    }
+};
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: %s trace.bin [output.json]\n", argv[0]);
+        return 1;
+    }
+
+    FILE* in = fopen(argv[1], "rb");
+    if (!in) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    bxi_trace_header header;
+    if (!BxiTrace::read_header(in, &header)) {
+        fprintf(stderr, "%s is not a S4BXI trace (or was written by an incompatible version)\n", argv[1]);
+        return 1;
+    }
+    header.simulation_id[sizeof(header.simulation_id) - 1] = '\0';
+    fprintf(stderr, "Converting trace of simulation %s\n", header.simulation_id);
+
+    FILE* out = argc > 2 ? fopen(argv[2], "w") : stdout;
+    if (!out) {
+        perror(argv[2]);
+        return 1;
+    }
+
+    {
+        ChromeWriter writer(out);
+        vector<bxi_trace_record> records(READ_RECORDS);
+        unsigned long count = 0;
+        size_t n;
+        while ((n = fread(records.data(), sizeof(bxi_trace_record), records.size(), in)) > 0)
+            for (size_t i = 0; i < n; ++i)
+                writer.write(records[i], count++);
+    }
+
+    fclose(in);
+    if (out != stdout)
+        fclose(out);
+
+    return 0;
+}
@@ -0,0 +1,96 @@
+/*
+ * Author: Julien EMMANUEL
+ * Copyright (C) 2019-2022 Bull S.A.S
+ * All rights reserved
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation,
+ * which comes with this package.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+/**
+ * Convert a binary trace (written in S4BXI_LOG_FOLDER) to the CSV logs that
+ * were generated by previous versions of S4BXI
+ *
+ * Usage: s4bxi-trace2csv trace.bin [output_folder]
+ *
+ * Without an output folder, a single CSV is written on stdout. Otherwise the
+ * output is split in log_0.csv, log_1.csv, etc. every 10000 operations, as the
+ * simulator used to do
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include "s4bxi/BxiTrace.hpp"
+
+using namespace std;
+
+#define LOGS_IN_FILE  10000
+#define READ_RECORDS  (1 << 16)
+#define CSV_HEADER    "operation_type,initiator_nid,target_nid,start_time,end_time"
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: %s trace.bin [output_folder]\n", argv[0]);
+        return 1;
+    }
+
+    FILE* in = fopen(argv[1], "rb");
+    if (!in) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    bxi_trace_header header;
+    if (!BxiTrace::read_header(in, &header)) {
+        fprintf(stderr, "%s is not a S4BXI trace (or was written by an incompatible version)\n", argv[1]);
+        return 1;
+    }
+    header.simulation_id[sizeof(header.simulation_id) - 1] = '\0';
+    fprintf(stderr, "Converting trace of simulation %s\n", header.simulation_id);
+
+    string folder = argc > 2 ? argv[2] : "";
+    ofstream file;
+    ostream* out = &cout;
+    if (folder.empty())
+        *out << CSV_HEADER << '\n';
+
+    vector<bxi_trace_record> records(READ_RECORDS);
+    unsigned long count = 0;
+    size_t n;
+    while ((n = fread(records.data(), sizeof(bxi_trace_record), records.size(), in)) > 0) {
+        for (size_t i = 0; i < n; ++i, ++count) {
+            if (!folder.empty() && count % LOGS_IN_FILE == 0) {
+                file.close();
+                file.open(folder + "/log_" + to_string(count / LOGS_IN_FILE) + ".csv");
+                if (!file) {
+                    fprintf(stderr, "Couldn't create CSV files in %s\n", folder.c_str());
+                    return 1;
+                }
+                file << CSV_HEADER << '\n';
+                out = &file;
+            }
+
+            BxiLog log;
+            log.start     = records[i].start;
+            log.end       = records[i].end;
+            log.type      = (bxi_log_type)records[i].type;
+            log.initiator = records[i].initiator;
+            log.target    = records[i].target;
+            *out << log << '\n';
+        }
+    }
+
+    fclose(in);
+
+    return 0;
+}
@@ -14,6 +14,9 @@
  * Lesser General Public License for more details.
  */
 
+#include <algorithm>
+#include <mutex>
+
 #include "s4bxi/s4ptl.hpp"
 #include "s4bxi/s4bxi_util.hpp"
 #include "s4bxi/s4bxi_xbt_log.h"
@@ -25,35 +28,47 @@ using namespace simgrid;
 
 S4BXI_LOG_NEW_DEFAULT_CATEGORY(bxi_s4ptl_ct, "Messages specific to s4ptl CT implementation");
 
+BxiWaiter::BxiWaiter() : mutex(s4u::Mutex::create()), cv(s4u::ConditionVariable::create()) {}
+
+// Comparator for a min-heap on the thresholds
+static bool later(const ActorWaitingCT& a, const ActorWaitingCT& b)
+{
+    return a.test > b.test;
+}
+
 BxiCT::BxiCT()
 {
     ptl_ct_event_t ev{0, 0};
     event = ev;
 }
 
+void BxiCT::add_waiter(ptl_size_t test, const shared_ptr<BxiWaiter>& waiter)
+{
+    // Stale entries are only removed when they get to the top of the heap, so the ones with a
+    // threshold that is never reached accumulate: clean them up from time to time
+    if (waiting.size() >= compaction_size) {
+        waiting.erase(remove_if(waiting.begin(), waiting.end(), [](const ActorWaitingCT& w) { return w.is_stale(); }),
+                      waiting.end());
+        make_heap(waiting.begin(), waiting.end(), later);
+        compaction_size = max<size_t>(64, 2 * waiting.size());
+    }
+
+    waiting.push_back(ActorWaitingCT{test, waiter->generation, waiter});
+    push_heap(waiting.begin(), waiting.end(), later);
+}
+
 void BxiCT::on_update()
 {
-    for (auto it = waiting.begin(); it != waiting.end(); ++it) {
-        if (it->test == event.success || event.failure) {
-            s4u::Actor* actor     = it->actor;
-            s4u::Mailbox* mailbox = it->mailbox;
-            waiting.erase(it--);
-
-            // We need to erase `it` from the vector before making any simcall, otherwise
-            // other actors could wreck the `waiting` vector during the execution of this
-            // very function (remember that any number of actor can be waken up and do a
-            // lot of things during a simcall such as `actor->resume()` for example)
-
-            if (actor) { // Wake up any actor that was suspended (by PtlCTWait)
-                actor->resume();
-            } else if (mailbox) { // Unlock any actor that is waiting on a PtlCTPoll
-                bool garbage = true;
-                mailbox->put_init(&garbage, 0)->set_copy_data_callback(&s4u::Comm::copy_pointer_callback)->wait();
-                free_random_mailbox(mailbox);
-            } else {
-                ptl_panic("We have a waiting struct in counter, but no actor to wake up or mailbox to contact");
-            }
-        }
+    while (!waiting.empty() && reached(waiting.front().test)) {
+        pop_heap(waiting.begin(), waiting.end(), later);
+        auto waiter = std::move(waiting.back());
+        waiting.pop_back();
+
+        // We need to remove the entry from the heap before making any simcall, otherwise other
+        // actors could wreck it during the execution of this very function (remember that any
+        // number of actors can be waken up and do a lot of things during a simcall)
+        if (!waiter.is_stale())
+            waiter.waiter->cv->notify_all();
     }
 }
 
@@ -82,64 +97,69 @@ int BxiCT::increment(ptl_ct_event_t increment)
     return PTL_OK;
 }
 
-int BxiCT::wait(ptl_size_t test, ptl_ct_event_t* ev)
+int BxiCT::wait(ptl_size_t test, ptl_ct_event_t* ev, const shared_ptr<BxiWaiter>& waiter)
 {
-    auto self = s4u::Actor::self();
-    if (event.success < test && !event.failure) {
-        waiting.push_back(ActorWaitingCT{self, nullptr, test});
-        self->suspend(); // When somebody increments the CT, they will wake us up if necessary
-    }
-
-    // If we get here, we were awakened by somebody
-    *ev = event;
+    ptl_handle_ct_t handle = this;
+    unsigned int which;
 
-    return PTL_OK;
+    return poll(&handle, &test, 1, PTL_TIME_FOREVER, ev, &which, waiter);
 }
 
 int BxiCT::poll(const ptl_handle_ct_t* ct_handles, const ptl_size_t* tests, unsigned int size, ptl_time_t timeout,
-                ptl_ct_event_t* event, unsigned int* which)
+                ptl_ct_event_t* event, unsigned int* which, const shared_ptr<BxiWaiter>& waiter)
 {
     if (timeout < 0 && timeout != PTL_TIME_FOREVER)
         XBT_ERROR("Incorrect timeout value in BxiCT::poll (expected >= 0 or PTL_TIME_FOREVER, got %ld)", timeout);
 
-    unsigned int i;
-    BxiCT* cts[size];
+    auto try_get = [&]() {
+        for (unsigned int i = 0; i < size; ++i) {
+            auto ct = (BxiCT*)ct_handles[i];
+            if (ct->reached(tests[i])) {
+                *which = i;
+                *event = ct->event;
+
+                return true;
+            }
+        }
 
-    for (i = 0; i < size; ++i)
-        cts[i] = (BxiCT*)ct_handles[i];
+        return false;
+    };
 
     // Check if a CT already fullfills the corresponding test
-    for (i = 0; i < size; ++i) {
-        if (cts[i]->event.success >= tests[i] || cts[i]->event.failure) {
-            *which = i;
-            *event = cts[i]->event;
+    if (try_get())
+        return PTL_OK;
+    if (!timeout)
+        return PTL_CT_NONE_REACHED;
 
-            return PTL_OK;
+    unique_lock<s4u::Mutex> lock(*waiter->mutex);
+    double deadline = s4u::Engine::get_clock() + timeout / 1000.0; // Portals time is in ms and SimGrid in s
+    int rc          = PTL_CT_NONE_REACHED;
+
+    for (;;) {
+        for (unsigned int i = 0; i < size; ++i)
+            ((BxiCT*)ct_handles[i])->add_waiter(tests[i], waiter);
+
+        // Taking the lock (or getting it back after a wakeup) yields, and an update of the CTs in the
+        // meantime found nobody to wake up: check again now that we're registered, before sleeping
+        bool timed_out = false;
+        if (!try_get()) {
+            if (timeout == PTL_TIME_FOREVER)
+                waiter->cv->wait(lock);
+            else
+                timed_out = waiter->cv->wait_until(lock, deadline) == cv_status::timeout;
         }
-    }
 
-    // This is somewhat similar to BxiEQ::poll
-    auto comms = vector<s4u::CommPtr>(size);
-    bool* garbage;
+        // Our entries are now useless, wherever they are
+        ++waiter->generation;
 
-    for (i = 0; i < size; ++i) {
-        auto ct      = cts[i];
-        auto waiting = ActorWaitingCT{nullptr, get_random_mailbox(), tests[i]};
-        ct->waiting.push_back(waiting);
-        comms[i] = waiting.mailbox->get_async<bool>(&garbage);
+        if (try_get()) {
+            rc = PTL_OK;
+            break;
+        }
+        if (timed_out)
+            break;
+        // We were waken up for nothing (a CT was set to a lower value in the meantime), register again
     }
 
-    unsigned int which_ct =
-        timeout == PTL_TIME_FOREVER ? s4u::Comm::wait_any(comms) : s4u::Comm::wait_any_for(comms, timeout / 1000.0F);
-
-    for (const auto& comm : comms)
-        comm->cancel();
-
-    if (which_ct < 0 || which_ct >= comms.size())
-        return PTL_CT_NONE_REACHED;
-
-    *event = cts[which_ct]->event;
-    *which = which_ct;
-
-    return PTL_OK;
-}
\ No newline at end of file
+    return rc;
+}
@@ -14,6 +14,9 @@
  * Lesser General Public License for more details.
  */
 
+#include <algorithm>
+#include <mutex>
+
 #include "s4bxi/s4ptl.hpp"
 #include "s4bxi/s4bxi_xbt_log.h"
 
@@ -22,106 +25,111 @@ using namespace simgrid;
 
 S4BXI_LOG_NEW_DEFAULT_CATEGORY(bxi_s4ptl_eq, "Messages specific to s4ptl EQ implementation");
 
-BxiEQ::BxiEQ()
+BxiEQ::BxiEQ(ptl_size_t capacity) : events(capacity ? capacity : 1), follows_drop(events.size(), false) {}
+
+void BxiEQ::push(const ptl_event_t* event)
 {
-    mailbox = get_random_mailbox();
-    mailbox->set_receiver(s4u::Actor::self());
+    if (count == events.size()) {
+        dropped = true;
+        ++dropped_count;
+        XBT_DEBUG("EQ %p is full (%lu events), dropping event of type %d", this, events.size(), event->type);
+
+        return;
+    }
+
+    // The gap is reported with the first event that made it in the queue after it
+    size_t slot        = (head + count) % events.size();
+    events[slot]       = *event;
+    follows_drop[slot] = dropped;
+    dropped            = false;
+    ++count;
+
+    // Waking up an actor is a simcall, during which the waiter could already be gone
+    // (and have removed itself from the vector), so iterate on a copy
+    auto to_wake = waiters;
+    for (const auto& waiter : to_wake)
+        waiter->cv->notify_all();
 }
 
-BxiEQ::~BxiEQ()
+int BxiEQ::pop(ptl_event_t* event)
 {
-    free_random_mailbox(mailbox);
+    bool gap = follows_drop[head];
+    *event   = events[head];
+    head     = (head + 1) % events.size();
+    --count;
+
+    return gap ? PTL_EQ_DROPPED : PTL_OK;
 }
 
 int BxiEQ::get(ptl_event_t* event)
 {
-    if (!mailbox->ready())
+    if (!count)
         return PTL_EQ_EMPTY;
 
-    return wait(event); // Instantaneous since we know the mailbox is ready
+    return pop(event);
 }
 
-int BxiEQ::wait(ptl_event_t* event)
+int BxiEQ::wait(ptl_event_t* event, const shared_ptr<BxiWaiter>& waiter)
 {
-    ptl_event_t* ev_ptr;
-    mailbox->get_init()
-        ->set_dst_data(reinterpret_cast<void**>(&ev_ptr), sizeof(void*))
-        ->set_copy_data_callback(&s4u::Comm::copy_pointer_callback)
-        ->wait();
-    *event = *ev_ptr;
-    delete ev_ptr;
-
-    return PTL_OK;
+    ptl_handle_eq_t handle = this;
+    unsigned int which;
+
+    return poll(&handle, 1, PTL_TIME_FOREVER, event, &which, waiter);
 }
 
 int BxiEQ::poll(const ptl_handle_eq_t* eq_handles, unsigned int size, ptl_time_t timeout, ptl_event_t* event,
-                unsigned int* which)
+                unsigned int* which, const shared_ptr<BxiWaiter>& waiter)
 {
     if (timeout < 0 && timeout != PTL_TIME_FOREVER)
         XBT_ERROR("Incorrect timeout value in BxiEQ::poll (expected >= 0 or PTL_TIME_FOREVER, got %ld)", timeout);
 
-    // ___//!\\___In case of emergency, use this safer (albeit slow) version___
-    //    unsigned int poll_count = 0;
-    //
-    //    double initial = s4u::Engine::get_clock();
-    //    for (;;) {
-    //        ++poll_count;
-    //        for (unsigned int i = 0; i < size; ++i) {
-    //            s4u::this_actor::sleep_for(1e-8 + (poll_count > 20 ? ((poll_count - 20) * 1e-8) : 0));
-    //            auto ret = ((BxiEQ*)eq_handles[i])->get(event);
-    //
-    //            if (ret == PTL_OK) {
-    //                *which = i;
-    //                return ret;
-    //            }
-    //        }
-    //        if (timeout != PTL_TIME_FOREVER && s4u::Engine::get_clock() >= initial + timeout / 1000)
-    //            return PTL_EQ_EMPTY;
-    //    }
-
-    // Probably useless, who knows actually
+    // Fast path: an event is already there
     for (unsigned int i = 0; i < size; ++i) {
-        auto eq = ((BxiEQ*)eq_handles[i]);
-
-        // First check if someone is ready or close to be
-        if (eq->mailbox->ready() || eq->mailbox->listen()) {
+        auto eq = (BxiEQ*)eq_handles[i];
+        if (!eq->empty()) {
             *which = i;
-            eq->wait(event); // In theory this isn't good, I guess than in some extreme cases it could make us
-                             // exceed the timeout, but it seems unlikely
-
-            return PTL_OK;
+            return eq->pop(event);
         }
     }
 
-    auto comms          = vector<s4u::CommPtr>(size);
-    ptl_event_t* ev_ptr = nullptr;
+    if (!timeout)
+        return PTL_EQ_EMPTY;
+
+    unique_lock<s4u::Mutex> lock(*waiter->mutex);
 
-    // Issue a get_async to the mailbox of each EQ,
-    // directly redirected to the user provided event
-    // structure in case of success
     for (unsigned int i = 0; i < size; ++i)
-        comms[i] = ((BxiEQ*)eq_handles[i])->mailbox->get_async<ptl_event_t>(&ev_ptr);
-
-    // Get an event or a timeout
-    unsigned int which_eq =
-        timeout == PTL_TIME_FOREVER
-            ? s4u::Comm::wait_any(comms)
-            : s4u::Comm::wait_any_for(comms, timeout / 1000.0F); // Portals time is in ms and SimGrid in s
-
-    // Thanks millian for the idea of CommPtr->cancel()
-    // (it seems safe to cancel all comms, even the one
-    // which gave us an event and is already finished)
-    for (const auto& comm : comms)
-        comm->cancel();
-
-    // I don't know what the exact rule is here, and gdb
-    // didn't help me that much, so this condition will do
-    if (which_eq < 0 || which_eq >= comms.size() || !ev_ptr)
-        return PTL_EQ_EMPTY;
+        ((BxiEQ*)eq_handles[i])->waiters.push_back(waiter);
+
+    double deadline = s4u::Engine::get_clock() + timeout / 1000.0; // Portals time is in ms and SimGrid in s
+    int rc          = PTL_EQ_EMPTY;
+    bool timed_out  = false;
+
+    // Locking the mutex yields, and nobody was registered to be woken up by an event pushed meanwhile,
+    // so look at the EQs again before the first wait. Another actor polling the same EQ could also
+    // have been faster than us after a wakeup, in which case we go back to sleep
+    for (;;) {
+        for (unsigned int i = 0; i < size; ++i) {
+            auto eq = (BxiEQ*)eq_handles[i];
+            if (!eq->empty()) {
+                *which = i;
+                rc     = eq->pop(event);
+                break;
+            }
+        }
 
-    *event = *ev_ptr;
-    *which = which_eq;
-    delete ev_ptr;
+        if (rc != PTL_EQ_EMPTY || timed_out)
+            break;
+
+        if (timeout == PTL_TIME_FOREVER)
+            waiter->cv->wait(lock);
+        else
+            timed_out = waiter->cv->wait_until(lock, deadline) == cv_status::timeout;
+    }
 
-    return PTL_OK;
-}
\ No newline at end of file
+    for (unsigned int i = 0; i < size; ++i) {
+        auto& waiters = ((BxiEQ*)eq_handles[i])->waiters;
+        waiters.erase(find(waiters.begin(), waiters.end(), waiter));
+    }
+
+    return rc;
+}
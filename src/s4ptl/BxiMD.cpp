@@ -39,4 +39,24 @@ void BxiMD::increment_ct(ptl_size_t byte_count)
 
     auto amount = HAS_PTL_OPTION(&md, PTL_MD_EVENT_CT_BYTES) ? byte_count : 1;
     ct->increment_success(amount);
-}
\ No newline at end of file
+}
+/**
+ * Drop the reference held by the user's handle, unless some operations will still issue events on
+ * this MD (PTL_IN_USE). Requests that completed but are still referenced by the NICs (E2E, unexpected
+ * headers, ...) keep the MD alive until they are deleted
+ */
+int BxiMD::release(BxiMD* md)
+{
+    if (md->pending_ops)
+        return PTL_IN_USE;
+
+    unref(md);
+
+    return PTL_OK;
+}
+
+void BxiMD::unref(BxiMD* md)
+{
+    if (!--md->ref_count)
+        delete md;
+}
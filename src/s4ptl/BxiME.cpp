@@ -74,14 +74,14 @@ void BxiME::append(BxiPT* pt, const ptl_me_t* me_t, ptl_list_t list, void* user_
     }
 
     // Insert in appropriate list
-    me->get_list(pt)->push_back(me);
+    pt->insert(me);
     if (!HAS_PTL_OPTION(me_t, PTL_ME_EVENT_LINK_DISABLE)) {
-        auto ev          = new ptl_event_t;
-        ev->type         = PTL_EVENT_LINK;
-        ev->ni_fail_type = PTL_OK;
-        ev->user_ptr     = user_ptr;
-        ev->pt_index     = me->pt->index;
-        pt->ni->node->issue_event(pt->eq, ev);
+        ptl_event_t ev;
+        ev.type         = PTL_EVENT_LINK;
+        ev.ni_fail_type = PTL_OK;
+        ev.user_ptr     = user_ptr;
+        ev.pt_index     = me->pt->index;
+        pt->ni->node->issue_event(pt->eq, &ev);
     }
 }
 
@@ -95,8 +95,7 @@ void BxiME::unlink(ptl_handle_me_t me_handle)
     }
 
     // No one is using the ME, destroy it
-    auto list = me->get_list();
-    list->erase(remove(list->begin(), list->end(), me));
+    me->pt->remove(me);
     delete me;
 }
 
@@ -136,7 +135,7 @@ ptl_addr_t BxiME::get_offsetted_addr(BxiMsg* msg, bool update_manage_local_offse
     return addr;
 }
 
-shared_ptr<BxiList> BxiME::get_list()
+BxiList* BxiME::get_list()
 {
     return get_list(pt);
 }
@@ -144,9 +143,9 @@ shared_ptr<BxiList> BxiME::get_list()
 /**
  * Used in case the PT has not been set in the ME yet
  */
-shared_ptr<BxiList> BxiME::get_list(BxiPT* considered_pt)
+BxiList* BxiME::get_list(BxiPT* considered_pt)
 {
-    return list == PTL_PRIORITY_LIST ? considered_pt->priority_list : considered_pt->overflow_list;
+    return list == PTL_PRIORITY_LIST ? &considered_pt->priority_list : &considered_pt->overflow_list;
 }
 
 /**
@@ -180,12 +179,12 @@ bool BxiME::maybe_auto_unlink(BxiME* me)
 
     // Log event if flag is not set
     if (should_log_event) {
-        auto event          = new ptl_event_t;
-        event->type         = PTL_EVENT_AUTO_UNLINK;
-        event->ni_fail_type = PTL_OK;
-        event->pt_index     = pt->index;
-        event->user_ptr     = user_ptr;
-        pt->ni->node->issue_event(eq, event);
+        ptl_event_t event;
+        event.type         = PTL_EVENT_AUTO_UNLINK;
+        event.ni_fail_type = PTL_OK;
+        event.pt_index     = pt->index;
+        event.user_ptr     = user_ptr;
+        pt->ni->node->issue_event(eq, &event);
     }
 
     return true;
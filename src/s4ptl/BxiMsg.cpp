@@ -39,6 +39,7 @@ BxiMsg::BxiMsg(const BxiMsg& msg)
     , target(msg.target)
     , type(msg.type)
     , send_init_time(msg.send_init_time)
+    , first_send_time(msg.first_send_time)
     , simulated_size(msg.simulated_size)
     , retry_count(msg.retry_count)
     , parent_request(msg.parent_request)
@@ -60,7 +61,11 @@ BxiMsg::~BxiMsg()
     if (!--parent_request->msg_ref_count) {
         switch (parent_request->type) {
         case S4BXI_FETCH_ATOMIC_REQUEST:
-            delete (BxiFetchAtomicRequest*)parent_request;
+            // Swaps share the FETCH_ATOMIC type, but they are a bigger object
+            if (((BxiFetchAtomicRequest*)parent_request)->is_swap_request())
+                delete (BxiSwapRequest*)parent_request;
+            else
+                delete (BxiFetchAtomicRequest*)parent_request;
             break;
         case S4BXI_ATOMIC_REQUEST:
             delete (BxiAtomicRequest*)parent_request;
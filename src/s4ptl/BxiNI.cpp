@@ -79,6 +79,18 @@ bool BxiNI::can_match_request(BxiRequest* req)
            HAS_PTL_OPTION(this, PTL_NI_MATCHING) == req->matching;
 }
 
+/**
+ * @return PT_INDEXES_COUNT if all indexes are in use
+ */
+ptl_pt_index_t BxiNI::first_free_pt_index() const
+{
+    for (int i = 0; i < PT_INDEXES_COUNT / 64; ++i)
+        if (~used_pt_indexes[i])
+            return i * 64 + __builtin_ctzll(~used_pt_indexes[i]);
+
+    return PT_INDEXES_COUNT;
+}
+
 ptl_rank_t BxiNI::get_l2p_rank()
 {
     for (int i = 0; i < l2p_map.size(); ++i) {
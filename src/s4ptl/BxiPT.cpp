@@ -23,32 +23,152 @@ using namespace simgrid;
 
 S4BXI_LOG_NEW_DEFAULT_CATEGORY(bxi_s4ptl_pt, "Messages specific to s4ptl PT implementation");
 
-BxiPT::BxiPT(ptl_handle_ni_t ni_handle, ptl_handle_eq_t eq_handle, ptl_index_t index, unsigned int options)
-    : ni((BxiNI*)ni_handle), eq((BxiEQ*)eq_handle), index(index), options(options)
+void BxiMEChain::push_back(BxiME* me)
+{
+    me->idx_prev = tail;
+    me->idx_next = nullptr;
+    if (tail)
+        tail->idx_next = me;
+    else
+        head = me;
+    tail = me;
+}
+
+void BxiMEChain::erase(BxiME* me)
+{
+    if (me->idx_prev)
+        me->idx_prev->idx_next = me->idx_next;
+    else
+        head = me->idx_next;
+    if (me->idx_next)
+        me->idx_next->idx_prev = me->idx_prev;
+    else
+        tail = me->idx_prev;
+    me->idx_prev = nullptr;
+    me->idx_next = nullptr;
+}
+
+void BxiList::push_back(BxiME* me)
+{
+    me->list_prev = tail;
+    me->list_next = nullptr;
+    if (tail)
+        tail->list_next = me;
+    else
+        head = me;
+    tail = me;
+    ++count;
+}
+
+void BxiList::erase(BxiME* me)
+{
+    if (me->list_prev)
+        me->list_prev->list_next = me->list_next;
+    else
+        head = me->list_next;
+    if (me->list_next)
+        me->list_next->list_prev = me->list_prev;
+    else
+        tail = me->list_prev;
+    me->list_prev = nullptr;
+    me->list_next = nullptr;
+    --count;
+}
+
+void BxiMatchIndex::insert(BxiME* me)
+{
+    if (me->me->ignore_bits)
+        wildcards.push_back(me);
+    else
+        exact[me->me->match_bits].push_back(me);
+}
+
+void BxiMatchIndex::remove(BxiME* me)
 {
-    priority_list = make_shared<BxiList>();
-    overflow_list = make_shared<BxiList>();
+    if (me->me->ignore_bits) {
+        wildcards.erase(me);
+        return;
+    }
+
+    auto bucket = exact.find(me->me->match_bits);
+    if (bucket == exact.end())
+        return;
+    bucket->second.erase(me);
+    if (!bucket->second.head)
+        exact.erase(bucket);
 }
 
 /**
- * There should definitely be more verification before doing `*actual = desired;` here,
- * especially if desired = PTL_PT_ANY ...
+ * Find the first entry (in insertion order) matching the request. We take the first
+ * candidate from the exact bucket, and only have to look at wildcards that were
+ * appended before it
  */
+BxiME* BxiMatchIndex::find(BxiRequest* req)
+{
+    BxiME* found = nullptr;
+
+    auto bucket = exact.find(req->match_bits);
+    if (bucket != exact.end()) {
+        for (auto me = bucket->second.head; me; me = me->idx_next) {
+            if (me->matches_request(req)) {
+                found = me;
+                break;
+            }
+        }
+    }
+
+    for (auto me = wildcards.head; me && (!found || me->seq < found->seq); me = me->idx_next)
+        if (me->matches_request(req))
+            return me;
+
+    return found;
+}
+
+void BxiMatchIndex::clear()
+{
+    exact.clear();
+    wildcards.head = nullptr;
+    wildcards.tail = nullptr;
+}
+
+BxiPT::BxiPT(ptl_handle_ni_t ni_handle, ptl_handle_eq_t eq_handle, ptl_index_t index, unsigned int options)
+    : ni((BxiNI*)ni_handle), eq((BxiEQ*)eq_handle), index(index), options(options)
+{
+    // Non-matching NIs only have LEs, which don't have any match bits to index
+    indexed                    = S4BXI_GLOBAL_CONFIG(indexed_matching) && HAS_PTL_OPTION(ni, PTL_NI_MATCHING);
+    unexpected_headers.indexed = indexed;
+}
+
 int BxiPT::alloc(ptl_handle_ni_t ni_handle, unsigned int options, ptl_handle_eq_t eq_handle, ptl_index_t desired,
                  ptl_index_t* actual)
 {
-    *actual = desired;
     auto ni = (BxiNI*)ni_handle;
-    ni->pt_indexes.insert(pair<ptl_pt_index_t, BxiPT*>(*actual, new BxiPT(ni_handle, eq_handle, *actual, options)));
+
+    if (desired == PTL_PT_ANY) {
+        desired = ni->first_free_pt_index();
+        if (desired > ni->limits->max_pt_index)
+            return PTL_PT_FULL;
+    } else if (desired > ni->limits->max_pt_index) {
+        return PTL_ARG_INVALID;
+    } else if (ni->pt_indexes[desired]) {
+        return PTL_PT_IN_USE;
+    }
+
+    *actual                 = desired;
+    ni->pt_indexes[desired] = new BxiPT(ni_handle, eq_handle, desired, options);
+    ni->used_pt_indexes[desired / 64] |= 1ULL << (desired % 64);
 
     return PTL_OK;
 }
 
+/**
+ * @return nullptr if the PT isn't allocated
+ */
 BxiPT* BxiPT::getFromNI(ptl_handle_ni_t ni_handle, ptl_pt_index_t pt_index)
 {
     auto n = (BxiNI*)ni_handle;
 
-    return n->pt_indexes.at(pt_index);
+    return pt_index < PT_INDEXES_COUNT ? n->pt_indexes[pt_index] : nullptr;
 }
 
 int BxiPT::enable()
@@ -69,46 +189,95 @@ int BxiPT::free(ptl_handle_ni_t ni_handle, ptl_index_t pt_index)
 {
     auto n    = (BxiNI*)ni_handle;
     BxiPT* pt = getFromNI(ni_handle, pt_index);
+    if (!pt)
+        return PTL_ARG_INVALID;
 
     // Is this dangerous ? I can't tell, I don't think so
-    for (auto const& me : *pt->priority_list)
-        delete me;
-    for (auto const& me : *pt->overflow_list)
-        delete me;
-    for (auto const& header : pt->unexpected_headers)
+    for (auto list : {&pt->priority_list, &pt->overflow_list}) {
+        for (auto me = list->head; me;) {
+            auto next = me->list_next;
+            delete me;
+            me = next;
+        }
+        *list = BxiList();
+    }
+    for (auto header = pt->unexpected_headers.front(); header;) {
+        auto next = header->uh_next;
         delete header;
+        header = next;
+    }
 
-    pt->priority_list->clear();
-    pt->overflow_list->clear();
+    pt->priority_index.clear();
+    pt->overflow_index.clear();
     pt->unexpected_headers.clear();
-    n->pt_indexes.erase(pt_index);
+    n->pt_indexes[pt_index] = nullptr;
+    n->used_pt_indexes[pt_index / 64] &= ~(1ULL << (pt_index % 64));
 
     delete pt;
 
     return PTL_OK;
 }
 
+void BxiPT::insert(BxiME* me)
+{
+    me->seq = next_seq++;
+    me->get_list(this)->push_back(me);
+    if (indexed)
+        (me->list == PTL_PRIORITY_LIST ? priority_index : overflow_index).insert(me);
+}
+
+void BxiPT::remove(BxiME* me)
+{
+    me->get_list(this)->erase(me);
+    if (indexed)
+        (me->list == PTL_PRIORITY_LIST ? priority_index : overflow_index).remove(me);
+}
+
+BxiME* BxiPT::find_entry(ptl_list_t list, BxiRequest* req)
+{
+    if (indexed && req->matching)
+        return (list == PTL_PRIORITY_LIST ? priority_index : overflow_index).find(req);
+
+    for (auto me = (list == PTL_PRIORITY_LIST ? priority_list : overflow_list).head; me; me = me->list_next)
+        if (me->matches_request(req))
+            return me;
+
+    return nullptr;
+}
+
+/**
+ * Fill the fields of an event that describe an unexpected header, the caller
+ * still has to set the type, pt_index and user_ptr
+ */
+static void fill_UH_event(ptl_event_t* ev, const BxiRequest* req)
+{
+    ev->initiator    = ptl_process_t{.phys{.nid = req->md->ni->node->nid, .pid = req->md->ni->pid}};
+    ev->ni_fail_type = PTL_OK;
+    ev->rlength      = req->payload_size;
+    ev->mlength      = req->mlength;
+    ev->match_bits   = req->match_bits;
+    ev->start        = req->start;
+    if (req->type != S4BXI_GET_REQUEST) // All requests other than GET look like a PUT
+        ev->hdr_data = ((const BxiPutRequest*)req)->hdr;
+}
+
 BxiME* BxiPT::walk_through_lists(BxiMsg* msg)
 {
     if (!enabled) // This has probably already been checked, but who knows
         return nullptr;
 
     BxiRequest* req = msg->parent_request;
-    for (auto me : *priority_list) {
-        if (me->matches_request(req)) {
-            me->used = true;
+    if (auto me = find_entry(PTL_PRIORITY_LIST, req)) {
+        me->used = true;
 
-            return me;
-        }
+        return me;
     }
-    for (auto me : *overflow_list) {
-        if (me->matches_request(req)) {
-            me->used = true;
-            ++msg->ref_count;
-            unexpected_headers.push_back(msg);
+    if (auto me = find_entry(PTL_OVERFLOW_LIST, req)) {
+        me->used = true;
+        ++msg->ref_count;
+        unexpected_headers.push_back(msg);
 
-            return me;
-        }
+        return me;
     }
 
     return nullptr;
@@ -118,54 +287,100 @@ bool BxiPT::walk_through_UHs(BxiME* me)
 {
     bool matched = false;
 
-    for (int i = 0; i < unexpected_headers.size(); ++i) {
-        auto header = unexpected_headers[i];
-        auto req    = header->parent_request;
+    for (auto header = unexpected_headers.first_match(me); header;) {
+        auto req = header->parent_request;
+        matched  = true;
+        me->used = true;
 
-        if (me->matches_request(req)) {
-            matched  = true;
-            me->used = true;
+        // DON'T update manage_local offset of the ME here even if you really want to (see sec 3.12 in spec)
+        // also don't AUTO_UNLINK me : we simply don't insert it, so nothing to unlink
 
-            // DON'T update manage_local offset of the ME here even if you really want to (see sec 3.12 in spec)
-            // also don't AUTO_UNLINK me : we simply don't insert it, so nothing to unlink
+        ptl_event_t ev;
+        switch (req->type) {
+        case S4BXI_FETCH_ATOMIC_REQUEST:
+            ev.type = PTL_EVENT_FETCH_ATOMIC_OVERFLOW;
+            break;
+        case S4BXI_ATOMIC_REQUEST:
+            ev.type = PTL_EVENT_ATOMIC_OVERFLOW;
+            break;
+        case S4BXI_PUT_REQUEST:
+            ev.type = PTL_EVENT_PUT_OVERFLOW;
+            break;
+        case S4BXI_GET_REQUEST:
+            ev.type = PTL_EVENT_GET_OVERFLOW;
+            break;
+        default:
+            ptl_panic("Incorrect request type found when walking through UH\n");
+        }
+        fill_UH_event(&ev, req);
+        ev.pt_index = req->matched_me->pt->index;
+        ev.user_ptr = req->matched_me->user_ptr;
 
-            auto ev = new ptl_event_t;
-            switch (req->type) {
-            case S4BXI_FETCH_ATOMIC_REQUEST:
-                ev->type = PTL_EVENT_FETCH_ATOMIC_OVERFLOW;
-                break;
-            case S4BXI_ATOMIC_REQUEST:
-                ev->type = PTL_EVENT_ATOMIC_OVERFLOW;
-                break;
-            case S4BXI_PUT_REQUEST:
-                ev->type = PTL_EVENT_PUT_OVERFLOW;
-                break;
-            case S4BXI_GET_REQUEST:
-                ev->type = PTL_EVENT_GET_OVERFLOW;
-                break;
-            default:
-                ptl_panic("Incorrect request type found when walking through UH\n");
-            }
-            ev->initiator    = ptl_process_t{.phys{.nid = req->md->ni->node->nid, .pid = req->md->ni->pid}};
-            ev->ni_fail_type = PTL_OK;
-            ev->pt_index     = req->matched_me->pt->index;
-            ev->user_ptr     = req->matched_me->user_ptr;
-            ev->rlength      = req->payload_size;
-            ev->mlength      = req->mlength;
-            ev->match_bits   = req->match_bits;
-            ev->start        = req->start;
-            if (req->type != S4BXI_GET_REQUEST) // All requests other than GET look like a PUT
-                ev->hdr_data = ((BxiPutRequest*)req)->hdr;
-
-            unexpected_headers.erase(unexpected_headers.begin() + i--);
-            BxiMsg::unref(header);
+        // Only match once if use_once ME: don't walk the rest of the queue for nothing
+        auto use_once = HAS_PTL_OPTION(me->me, PTL_ME_USE_ONCE);
+        auto next     = use_once ? nullptr : unexpected_headers.next_match(me, header);
+        unexpected_headers.erase(header);
+        BxiMsg::unref(header);
 
-            ni->node->issue_event(eq, ev);
+        ni->node->issue_event(eq, &ev);
 
-            if (HAS_PTL_OPTION(me->me, PTL_ME_USE_ONCE)) // Only match once if use_once ME
-                return matched;
-        }
+        if (use_once)
+            return matched;
+
+        header = next;
     }
 
     return matched;
-}
\ No newline at end of file
+}
+
+/**
+ * Search the unexpected headers with an entry that is never linked (sec 3.12.5 in spec).
+ * PTL_SEARCH_ONLY reports the first matching header, PTL_SEARCH_DELETE consumes every
+ * matching header (only the first one for USE_ONCE entries), with a PTL_EVENT_SEARCH
+ * for each of them. If nothing matches we get a single PTL_EVENT_SEARCH with PTL_NI_NO_MATCH
+ */
+void BxiPT::search(const ptl_me_t* me_t, ptl_search_op_t op, void* user_ptr)
+{
+    BxiME me(this, me_t, PTL_PRIORITY_LIST, user_ptr);
+    bool found = false;
+
+    for (auto header = unexpected_headers.first_match(&me); header;) {
+        found = true;
+
+        if (!HAS_PTL_OPTION(me_t, PTL_ME_EVENT_SUCCESS_DISABLE)) {
+            ptl_event_t ev;
+            fill_UH_event(&ev, header->parent_request);
+            ev.type     = PTL_EVENT_SEARCH;
+            ev.pt_index = index;
+            ev.user_ptr = user_ptr;
+            ni->node->issue_event(eq, &ev);
+        }
+        if (HAS_PTL_OPTION(me_t, PTL_ME_EVENT_CT_OVERFLOW))
+            me.increment_ct(header->parent_request->mlength);
+
+        if (op != PTL_SEARCH_DELETE)
+            break;
+
+        if (HAS_PTL_OPTION(me_t, PTL_ME_USE_ONCE)) {
+            unexpected_headers.erase(header);
+            BxiMsg::unref(header);
+            break;
+        }
+
+        me.used   = true;
+        auto next = unexpected_headers.next_match(&me, header);
+        unexpected_headers.erase(header);
+        BxiMsg::unref(header);
+
+        header = next;
+    }
+
+    if (!found) {
+        ptl_event_t ev;
+        ev.type         = PTL_EVENT_SEARCH;
+        ev.ni_fail_type = PTL_NI_NO_MATCH;
+        ev.pt_index     = index;
+        ev.user_ptr     = user_ptr;
+        ni->node->issue_event(eq, &ev);
+    }
+}
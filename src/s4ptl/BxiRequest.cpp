@@ -27,7 +27,7 @@ BxiRequest::BxiRequest(bxi_req_type type, BxiMD* md, ptl_size_t payload_size, bo
                        bool service_vn, ptl_size_t local_offset, ptl_size_t remote_offset)
     : type(type)
     , payload_size(payload_size)
-    , md(make_shared<BxiMD>(*md))
+    , md(md)
     , matching(matching)
     , match_bits(match_bits)
     , target_pid(target_pid)
@@ -38,6 +38,30 @@ BxiRequest::BxiRequest(bxi_req_type type, BxiMD* md, ptl_size_t payload_size, bo
     , local_offset(local_offset)
     , remote_offset(remote_offset)
 {
+    ++md->ref_count;
+    ++md->pending_ops;
+}
+
+BxiRequest::~BxiRequest()
+{
+    end_md_use();
+    BxiMD::unref(md);
+}
+
+/**
+ * The request won't issue any more events on its MD(s), so the user can release them from now on
+ * (our reference still keeps them alive until the request is deleted, because retransmissions and
+ * E2E processing keep reading them)
+ */
+void BxiRequest::end_md_use()
+{
+    if (!md_in_use)
+        return;
+
+    md_in_use = false;
+    --md->pending_ops;
+    if (type == S4BXI_FETCH_ATOMIC_REQUEST)
+        --((BxiFetchAtomicRequest*)this)->get_md->pending_ops;
 }
 
 BxiPutRequest::BxiPutRequest(BxiMD* md, ptl_size_t payload_size, bool matching, ptl_match_bits_t match_bits,
@@ -53,16 +77,18 @@ BxiPutRequest::BxiPutRequest(BxiMD* md, ptl_size_t payload_size, bool matching,
 
 void BxiPutRequest::issue_ack(int ni_fail_type)
 {
+    end_md_use();
+
     if (HAS_PTL_OPTION(&md->md, PTL_MD_EVENT_CT_ACK))
         md->increment_ct(payload_size);
     if (ack_req == PTL_ACK_REQ) {
-        auto ack           = new ptl_event_t;
-        ack->type          = PTL_EVENT_ACK;
-        ack->ni_fail_type  = ni_fail_type;
-        ack->user_ptr      = user_ptr;
-        ack->mlength       = mlength;
-        ack->remote_offset = target_remote_offset;
-        (md->ni->node)->issue_event((BxiEQ*)md->md.eq_handle, ack);
+        ptl_event_t ack;
+        ack.type          = PTL_EVENT_ACK;
+        ack.ni_fail_type  = ni_fail_type;
+        ack.user_ptr      = user_ptr;
+        ack.mlength       = mlength;
+        ack.remote_offset = target_remote_offset;
+        (md->ni->node)->issue_event((BxiEQ*)md->md.eq_handle, &ack);
     }
 }
 
@@ -90,16 +116,20 @@ void BxiPutRequest::maybe_issue_send()
 
     send_event_issued = true;
 
+    // Without a Portals ACK this is the last event of the request
+    if (ack_req == PTL_NO_ACK_REQ && type != S4BXI_FETCH_ATOMIC_REQUEST)
+        end_md_use();
+
     if (HAS_PTL_OPTION(&md->md, PTL_MD_EVENT_CT_SEND))
         md->increment_ct(payload_size);
 
     if (!HAS_PTL_OPTION(&md->md, PTL_MD_EVENT_SEND_DISABLE) && !HAS_PTL_OPTION(&md->md, PTL_MD_EVENT_SUCCESS_DISABLE)) {
-        auto event          = new ptl_event_t;
-        event->type         = PTL_EVENT_SEND;
-        event->ni_fail_type = PTL_OK;
-        event->user_ptr     = user_ptr;
-        event->mlength      = payload_size; // SEND doesn't care about truncated payloads
-        (md->ni->node)->issue_event((BxiEQ*)md->md.eq_handle, event);
+        ptl_event_t event;
+        event.type         = PTL_EVENT_SEND;
+        event.ni_fail_type = PTL_OK;
+        event.user_ptr     = user_ptr;
+        event.mlength      = payload_size; // SEND doesn't care about truncated payloads
+        (md->ni->node)->issue_event((BxiEQ*)md->md.eq_handle, &event);
     }
 }
 
@@ -122,10 +152,18 @@ BxiFetchAtomicRequest::BxiFetchAtomicRequest(BxiMD* md, ptl_size_t payload_size,
                                              ptl_datatype_t datatype, BxiMD* get_md, ptl_size_t get_local_offset)
     : BxiAtomicRequest(md, payload_size, matching, match_bits, target_pid, pt_index, user_ptr, service_vn, local_offset,
                        remote_offset, PTL_NO_ACK_REQ /* unused, there will be a reply anyway */, hdr, op, datatype)
-    , get_md(make_shared<BxiMD>(*get_md))
+    , get_md(get_md)
     , get_local_offset(get_local_offset)
 {
     type = S4BXI_FETCH_ATOMIC_REQUEST; // Overwrite what ATOMIC constructor did
+    ++get_md->ref_count;
+    ++get_md->pending_ops;
+}
+
+BxiFetchAtomicRequest::~BxiFetchAtomicRequest()
+{
+    end_md_use(); // While we still know about get_md
+    BxiMD::unref(get_md);
 }
 
 bool BxiFetchAtomicRequest::is_swap_request()
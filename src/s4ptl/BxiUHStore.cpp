@@ -0,0 +1,147 @@
+/*
+ * Author: Julien EMMANUEL
+ * Copyright (C) 2019-2022 Bull S.A.S
+ * All rights reserved
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation,
+ * which comes with this package.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include "s4bxi/s4ptl.hpp"
+#include "s4bxi/s4bxi_util.hpp"
+#include "s4bxi/s4bxi_xbt_log.h"
+
+using namespace std;
+
+S4BXI_LOG_NEW_DEFAULT_CATEGORY(bxi_s4ptl_uh, "Messages specific to s4ptl unexpected headers implementation");
+
+/**
+ * An ME that doesn't ignore any bit can only match headers carrying its own match bits,
+ * so it only needs to look at the corresponding bucket
+ */
+bool BxiUHStore::uses_index(const BxiME* me) const
+{
+    return indexed && !me->me->ignore_bits;
+}
+
+void BxiUHStore::push_back(BxiMsg* msg)
+{
+    msg->uh_prev = arrival.tail;
+    msg->uh_next = nullptr;
+    if (arrival.tail)
+        arrival.tail->uh_next = msg;
+    else
+        arrival.head = msg;
+    arrival.tail = msg;
+    ++count;
+
+    if (!indexed)
+        return;
+
+    auto& bucket        = buckets[msg->parent_request->match_bits];
+    msg->uh_bucket_prev = bucket.tail;
+    msg->uh_bucket_next = nullptr;
+    if (bucket.tail)
+        bucket.tail->uh_bucket_next = msg;
+    else
+        bucket.head = msg;
+    bucket.tail = msg;
+}
+
+void BxiUHStore::erase(BxiMsg* msg)
+{
+    if (msg->uh_prev)
+        msg->uh_prev->uh_next = msg->uh_next;
+    else
+        arrival.head = msg->uh_next;
+    if (msg->uh_next)
+        msg->uh_next->uh_prev = msg->uh_prev;
+    else
+        arrival.tail = msg->uh_prev;
+    msg->uh_prev = nullptr;
+    msg->uh_next = nullptr;
+    --count;
+
+    if (!indexed)
+        return;
+
+    auto bucket = buckets.find(msg->parent_request->match_bits);
+    if (bucket == buckets.end())
+        return;
+
+    if (msg->uh_bucket_prev)
+        msg->uh_bucket_prev->uh_bucket_next = msg->uh_bucket_next;
+    else
+        bucket->second.head = msg->uh_bucket_next;
+    if (msg->uh_bucket_next)
+        msg->uh_bucket_next->uh_bucket_prev = msg->uh_bucket_prev;
+    else
+        bucket->second.tail = msg->uh_bucket_prev;
+    msg->uh_bucket_prev = nullptr;
+    msg->uh_bucket_next = nullptr;
+
+    if (!bucket->second.head)
+        buckets.erase(bucket);
+}
+
+/**
+ * Oldest unexpected header matching the ME
+ */
+BxiMsg* BxiUHStore::first_match(BxiME* me) const
+{
+    if (uses_index(me)) {
+        auto bucket = buckets.find(me->me->match_bits);
+        if (bucket == buckets.end())
+            return nullptr;
+
+        for (auto msg = bucket->second.head; msg; msg = msg->uh_bucket_next)
+            if (me->matches_request(msg->parent_request))
+                return msg;
+
+        return nullptr;
+    }
+
+    for (auto msg = arrival.head; msg; msg = msg->uh_next)
+        if (me->matches_request(msg->parent_request))
+            return msg;
+
+    return nullptr;
+}
+
+/**
+ * Oldest unexpected header matching the ME that arrived after `msg` (which must still be in the store)
+ */
+BxiMsg* BxiUHStore::next_match(BxiME* me, const BxiMsg* msg) const
+{
+    if (uses_index(me)) {
+        for (auto next = msg->uh_bucket_next; next; next = next->uh_bucket_next)
+            if (me->matches_request(next->parent_request))
+                return next;
+
+        return nullptr;
+    }
+
+    for (auto next = msg->uh_next; next; next = next->uh_next)
+        if (me->matches_request(next->parent_request))
+            return next;
+
+    return nullptr;
+}
+
+/**
+ * Forget about all headers, without freeing them
+ */
+void BxiUHStore::clear()
+{
+    arrival.head = nullptr;
+    arrival.tail = nullptr;
+    buckets.clear();
+    count = 0;
+}
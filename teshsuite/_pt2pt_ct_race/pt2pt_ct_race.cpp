@@ -0,0 +1,89 @@
+/*
+ * Author: Julien EMMANUEL
+ * Copyright (C) 2019-2022 Bull S.A.S
+ * All rights reserved
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation,
+ * which comes with this package.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include <portals4.h>
+#include <portals4_bxiext.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+
+// Each process waits on its own CT during half of the rounds, and increments the CT of its peer
+// during the other half, so that both scheduling orders are tried
+#define ROUNDS 10
+
+void ptlerr(std::string str, int rc)
+{
+    fprintf(stderr, "%s: %s\n", str.c_str(), PtlToStr(rc, PTL_STR_ERROR));
+}
+
+int main(int argc, char* argv[])
+{
+    int rank = s4bxi_get_my_rank();
+
+    int rc = PtlInit();
+    if (rc != PTL_OK) {
+        ptlerr("PtlInit", rc);
+        return rc;
+    }
+    ptl_handle_ni_t nih;
+    rc = PtlNIInit(PTL_IFACE_DEFAULT, PTL_NI_MATCHING | PTL_NI_PHYSICAL, 123, NULL, NULL, &nih);
+    if (rc != PTL_OK) {
+        ptlerr("PtlNIInit", rc);
+        return rc;
+    }
+
+    ptl_handle_ct_t cth;
+    rc = PtlCTAlloc(nih, &cth);
+    if (rc != PTL_OK) {
+        ptlerr("PtlCTAlloc", rc);
+        return rc;
+    }
+
+    // CT handles are plain pointers in the simulator, so the peer can increment our CT directly
+    s4bxi_keyval_store_pointer((char*)"ct", cth);
+    s4bxi_barrier();
+    auto peer_cth = (ptl_handle_ct_t)s4bxi_keyval_fetch_pointer(1 - rank, (char*)"ct");
+
+    ptl_ct_event_t inc = {1, 0};
+    ptl_ct_event_t ev;
+
+    for (int i = 0; i < ROUNDS; ++i) {
+        // Both processes leave the barrier at the same date: the increment happens either before the
+        // waiter checks its CT, or while it is setting up its wait
+        s4bxi_barrier();
+
+        if (i % 2 == rank) {
+            rc = PtlCTWait(cth, i / 2 + 1, &ev);
+            if (rc != PTL_OK) {
+                ptlerr("PtlCTWait", rc);
+                return rc;
+            }
+            printf("Round %d: rank %d got %lu\n", i, rank, ev.success);
+        } else {
+            PtlCTInc(peer_cth, inc);
+        }
+    }
+
+    s4bxi_barrier();
+
+    PtlCTFree(cth);
+    PtlNIFini(nih);
+    PtlFini();
+
+    return 0;
+}
@@ -0,0 +1,236 @@
+/*
+ * Author: Julien EMMANUEL
+ * Copyright (C) 2019-2022 Bull S.A.S
+ * All rights reserved
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation,
+ * which comes with this package.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include <portals4.h>
+#include <portals4_bxiext.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+
+// The target's EQ can only hold 2 events
+#define EQ_SIZE 2
+// Puts sent before the target reads anything, the last one is dropped
+#define FIRST_PUTS 3
+
+void ptlerr(std::string str, int rc)
+{
+    fprintf(stderr, "%s: %s\n", str.c_str(), PtlToStr(rc, PTL_STR_ERROR));
+}
+
+int put_and_wait_ack(ptl_handle_md_t mdh, ptl_process_t peer, ptl_handle_eq_t eqh)
+{
+    ptl_event_t ev;
+
+    int rc = PtlPut(mdh, 0, sizeof(int64_t), PTL_ACK_REQ, peer, 0, 0, 0, NULL, 0);
+    if (rc != PTL_OK) {
+        ptlerr("client: PtlPut", rc);
+        return rc;
+    }
+
+    PtlEQWait(eqh, &ev);
+    if (ev.type != PTL_EVENT_ACK) {
+        fprintf(stderr, "Wrong event type, got %u instead of ACK (%u)", ev.type, PTL_EVENT_ACK);
+        return 1;
+    }
+
+    return PTL_OK;
+}
+
+int client(char* target)
+{
+    int target_nid = atoi(target);
+
+    int rc = PtlInit();
+    if (rc != PTL_OK) {
+        ptlerr("client: PtlInit", rc);
+        return rc;
+    }
+    ptl_handle_ni_t nih;
+    rc = PtlNIInit(PTL_IFACE_DEFAULT, PTL_NI_MATCHING | PTL_NI_PHYSICAL, 2345, NULL, NULL, &nih);
+    if (rc != PTL_OK) {
+        ptlerr("client: PtlNIInit", rc);
+        return rc;
+    }
+
+    ptl_md_t mdpar;
+    ptl_handle_eq_t eqh;
+    ptl_handle_md_t mdh;
+    ptl_process_t peer;
+
+    rc = PtlEQAlloc(nih, 64, &eqh);
+    if (rc != PTL_OK) {
+        ptlerr("client: PtlEQAlloc", rc);
+        return rc;
+    }
+
+    peer.phys.nid = target_nid;
+    peer.phys.pid = 2345;
+
+    int64_t* i64 = (int64_t*)S4BXI_SHARED_MALLOC(sizeof(int64_t));
+    *i64         = 42;
+
+    mdpar.start     = i64;
+    mdpar.length    = sizeof(int64_t);
+    mdpar.eq_handle = eqh;
+    mdpar.ct_handle = PTL_CT_NONE;
+    mdpar.options   = PTL_MD_EVENT_SEND_DISABLE;
+
+    rc = PtlMDBind(nih, &mdpar, &mdh);
+    if (rc != PTL_OK) {
+        ptlerr("client: PtlMDBind", rc);
+        return rc;
+    }
+
+    s4bxi_barrier();
+
+    for (int i = 0; i < FIRST_PUTS; ++i)
+        if ((rc = put_and_wait_ack(mdh, peer, eqh)) != PTL_OK)
+            return rc;
+
+    s4bxi_barrier(); // The target empties its EQ
+    s4bxi_barrier();
+
+    if ((rc = put_and_wait_ack(mdh, peer, eqh)) != PTL_OK)
+        return rc;
+
+    s4bxi_barrier();
+
+    rc = PtlMDRelease(mdh);
+    if (rc != PTL_OK) {
+        ptlerr("client: PtlMDRelease", rc);
+        return rc;
+    }
+
+    S4BXI_SHARED_FREE(i64);
+
+    rc = PtlEQFree(eqh);
+    if (rc != PTL_OK) {
+        ptlerr("client: PtlEQFree", rc);
+        return rc;
+    }
+
+    rc = PtlNIFini(nih);
+    if (rc != PTL_OK) {
+        ptlerr("client: PtlNIFini", rc);
+        return rc;
+    }
+    PtlFini();
+
+    return 0;
+}
+
+void print_event(int rc, ptl_event_t* ev)
+{
+    if (rc == PTL_EQ_EMPTY)
+        printf("EQ is empty\n");
+    else
+        printf("Got %s with %s\n", PtlToStr(ev->type, PTL_STR_EVENT), PtlToStr(rc, PTL_STR_ERROR));
+}
+
+int server()
+{
+    ptl_handle_ni_t nih;
+    int rc = PtlInit();
+    if (rc != PTL_OK) {
+        ptlerr("server: PtlInit", rc);
+        return rc;
+    }
+
+    rc = PtlNIInit(PTL_IFACE_DEFAULT, PTL_NI_MATCHING | PTL_NI_PHYSICAL, 2345, NULL, NULL, &nih);
+    if (rc != PTL_OK) {
+        ptlerr("server: PtlNIInit", rc);
+        return rc;
+    }
+
+    ptl_handle_eq_t eqh;
+
+    rc = PtlEQAlloc(nih, EQ_SIZE, &eqh);
+    if (rc != PTL_OK) {
+        ptlerr("server: PtlEQAlloc", rc);
+        return rc;
+    }
+
+    ptl_pt_index_t pte;
+
+    rc = PtlPTAlloc(nih, 0, eqh, 0, &pte);
+    if (rc != PTL_OK) {
+        ptlerr("server: PtlPTAlloc", rc);
+        return rc;
+    }
+    ptl_event_t ev;
+
+    int64_t* buf = (int64_t*)S4BXI_SHARED_MALLOC(sizeof(int64_t));
+    ptl_me_t mepar;
+    ptl_handle_me_t meh;
+
+    memset(&mepar, 0, sizeof(ptl_me_t));
+    mepar.start     = buf;
+    mepar.length    = sizeof(int64_t);
+    mepar.ct_handle = PTL_CT_NONE;
+    mepar.uid       = PTL_UID_ANY;
+    mepar.options   = PTL_ME_OP_PUT | PTL_ME_EVENT_LINK_DISABLE | PTL_ME_EVENT_UNLINK_DISABLE;
+
+    rc = PtlMEAppend(nih, pte, &mepar, PTL_PRIORITY_LIST, NULL, &meh);
+    if (rc != PTL_OK) {
+        ptlerr("server: PtlMEAppend", rc);
+        return rc;
+    }
+
+    s4bxi_barrier();
+    s4bxi_barrier(); // All the first Puts are done
+
+    for (int i = 0; i <= EQ_SIZE; ++i)
+        print_event(PtlEQGet(eqh, &ev), &ev);
+
+    s4bxi_barrier();
+    s4bxi_barrier(); // Last Put is done
+
+    print_event(PtlEQWait(eqh, &ev), &ev);
+
+    PtlMEUnlink(meh);
+
+    S4BXI_SHARED_FREE(buf);
+
+    rc = PtlPTFree(nih, pte);
+    if (rc != PTL_OK) {
+        ptlerr("server: PtlPTFree", rc);
+        return rc;
+    }
+
+    rc = PtlEQFree(eqh);
+    if (rc != PTL_OK) {
+        ptlerr("server: PtlEQFree", rc);
+        return rc;
+    }
+
+    rc = PtlNIFini(nih);
+    if (rc != PTL_OK) {
+        ptlerr("server: PtlNIFini", rc);
+        return rc;
+    }
+
+    PtlFini();
+
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    // the client has a parameter (who the server is)
+    return argc > 1 ? client(argv[1]) : server();
+}
@@ -0,0 +1,157 @@
+/*
+ * Author: Julien EMMANUEL
+ * Copyright (C) 2019-2022 Bull S.A.S
+ * All rights reserved
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation,
+ * which comes with this package.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include <portals4.h>
+#include <portals4_bxiext.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+
+// Bigger than the inline part of a command, but small enough for PIO
+#define PAYLOAD_SIZE 256
+
+void ptlerr(std::string str, int rc)
+{
+    fprintf(stderr, "%s: %s\n", str.c_str(), PtlToStr(rc, PTL_STR_ERROR));
+}
+
+int client(char* target)
+{
+    int target_nid = atoi(target);
+
+    int rc = PtlInit();
+    if (rc != PTL_OK) {
+        ptlerr("client: PtlInit", rc);
+        return rc;
+    }
+    ptl_handle_ni_t nih;
+    rc = PtlNIInit(PTL_IFACE_DEFAULT, PTL_NI_MATCHING | PTL_NI_PHYSICAL, 123, NULL, NULL, &nih);
+    if (rc != PTL_OK) {
+        ptlerr("client: PtlNIInit", rc);
+        return rc;
+    }
+
+    ptl_handle_eq_t eqh;
+    rc = PtlEQAlloc(nih, 64, &eqh);
+    if (rc != PTL_OK) {
+        ptlerr("client: PtlEQAlloc", rc);
+        return rc;
+    }
+
+    ptl_process_t peer;
+    peer.phys.nid = target_nid;
+    peer.phys.pid = 123;
+
+    char buf[PAYLOAD_SIZE] = {};
+
+    ptl_md_t mdpar;
+    ptl_handle_md_t mdh;
+    mdpar.start     = buf;
+    mdpar.length    = PAYLOAD_SIZE;
+    mdpar.eq_handle = eqh;
+    mdpar.ct_handle = PTL_CT_NONE;
+    mdpar.options   = PTL_MD_EVENT_SEND_DISABLE | PTL_MD_VOLATILE; // PIO is only used for volatile MDs
+
+    rc = PtlMDBind(nih, &mdpar, &mdh);
+    if (rc != PTL_OK) {
+        ptlerr("client: PtlMDBind", rc);
+        return rc;
+    }
+
+    s4bxi_barrier();
+
+    rc = PtlPut(mdh, 0, PAYLOAD_SIZE, PTL_ACK_REQ, peer, 0, 42, 0, NULL, 0);
+    if (rc != PTL_OK) {
+        ptlerr("client: PtlPut", rc);
+        return rc;
+    }
+
+    ptl_event_t ev;
+    PtlEQWait(eqh, &ev);
+    if (ev.type != PTL_EVENT_ACK) {
+        fprintf(stderr, "Wrong event type, got %u instead of ACK (%u)", ev.type, PTL_EVENT_ACK);
+        return 1;
+    }
+    printf("Got PTL_EVENT_ACK\n");
+
+    s4bxi_barrier();
+
+    PtlMDRelease(mdh);
+    PtlEQFree(eqh);
+    PtlNIFini(nih);
+    PtlFini();
+
+    return 0;
+}
+
+int server()
+{
+    int rc = PtlInit();
+    if (rc != PTL_OK) {
+        ptlerr("server: PtlInit", rc);
+        return rc;
+    }
+    ptl_handle_ni_t nih;
+    rc = PtlNIInit(PTL_IFACE_DEFAULT, PTL_NI_MATCHING | PTL_NI_PHYSICAL, 123, NULL, NULL, &nih);
+    if (rc != PTL_OK) {
+        ptlerr("server: PtlNIInit", rc);
+        return rc;
+    }
+
+    ptl_pt_index_t pte;
+    rc = PtlPTAlloc(nih, 0, PTL_EQ_NONE, 0, &pte);
+    if (rc != PTL_OK) {
+        ptlerr("server: PtlPTAlloc", rc);
+        return rc;
+    }
+
+    char buf[PAYLOAD_SIZE];
+
+    ptl_me_t mepar;
+    ptl_handle_me_t meh;
+    memset(&mepar, 0, sizeof(ptl_me_t));
+    mepar.start       = buf;
+    mepar.length      = PAYLOAD_SIZE;
+    mepar.ct_handle   = PTL_CT_NONE;
+    mepar.match_bits  = 42;
+    mepar.ignore_bits = 0;
+    mepar.uid         = PTL_UID_ANY;
+    mepar.options     = PTL_ME_OP_PUT;
+
+    rc = PtlMEAppend(nih, pte, &mepar, PTL_PRIORITY_LIST, NULL, &meh);
+    if (rc != PTL_OK) {
+        ptlerr("server: PtlMEAppend", rc);
+        return rc;
+    }
+
+    s4bxi_barrier();
+    s4bxi_barrier(); // The client got its ACK
+
+    PtlMEUnlink(meh);
+    PtlPTFree(nih, pte);
+    PtlNIFini(nih);
+    PtlFini();
+
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    // the client has a parameter (who the server is)
+    return argc > 1 ? client(argv[1]) : server();
+}
@@ -0,0 +1,267 @@
+/*
+ * Author: Julien EMMANUEL
+ * Copyright (C) 2019-2022 Bull S.A.S
+ * All rights reserved
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation,
+ * which comes with this package.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include <portals4.h>
+#include <portals4_bxiext.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+
+#define PUT_NUMBER 2
+
+void ptlerr(std::string str, int rc)
+{
+    fprintf(stderr, "%s: %s\n", str.c_str(), PtlToStr(rc, PTL_STR_ERROR));
+}
+
+int client(char* target)
+{
+    int target_nid = atoi(target);
+
+    int rc = PtlInit();
+    if (rc != PTL_OK) {
+        ptlerr("client: PtlInit", rc);
+        return rc;
+    }
+    ptl_handle_ni_t nih;
+    rc = PtlNIInit(PTL_IFACE_DEFAULT, PTL_NI_MATCHING | PTL_NI_PHYSICAL, 2345, NULL, NULL, &nih);
+    if (rc != PTL_OK) {
+        ptlerr("client: PtlNIInit", rc);
+        return rc;
+    }
+
+    ptl_md_t mdpar;
+    ptl_handle_eq_t eqh;
+    ptl_handle_md_t mdh;
+    ptl_process_t peer;
+    ptl_event_t ev;
+
+    rc = PtlEQAlloc(nih, 64, &eqh);
+    if (rc != PTL_OK) {
+        ptlerr("client: PtlEQAlloc", rc);
+        return rc;
+    }
+
+    peer.phys.nid = target_nid;
+    peer.phys.pid = 2345;
+
+    int64_t* i64 = (int64_t*)S4BXI_SHARED_MALLOC(sizeof(int64_t));
+    *i64         = 42;
+
+    mdpar.start     = i64;
+    mdpar.length    = sizeof(int64_t);
+    mdpar.eq_handle = eqh;
+    mdpar.ct_handle = PTL_CT_NONE;
+    mdpar.options   = PTL_MD_EVENT_SEND_DISABLE;
+
+    rc = PtlMDBind(nih, &mdpar, &mdh);
+    if (rc != PTL_OK) {
+        ptlerr("client: PtlMDBind", rc);
+        return rc;
+    }
+
+    s4bxi_barrier();
+
+    for (int i = 0; i < PUT_NUMBER; ++i) {
+        rc = PtlPut(mdh, 0, sizeof(int64_t), PTL_ACK_REQ, peer, 0, 42 + i, 0, NULL, i);
+        if (rc != PTL_OK) {
+            ptlerr("client: PtlPut", rc);
+            return rc;
+        }
+
+        // Wait for each ACK so that Puts reach the target in order
+        PtlEQWait(eqh, &ev);
+        if (ev.type != PTL_EVENT_ACK) {
+            fprintf(stderr, "Wrong event type, got %u instead of ACK (%u)", ev.type, PTL_EVENT_ACK);
+            return 1;
+        }
+    }
+
+    s4bxi_barrier();
+
+    rc = PtlMDRelease(mdh);
+    if (rc != PTL_OK) {
+        ptlerr("client: PtlMDRelease", rc);
+        return rc;
+    }
+
+    S4BXI_SHARED_FREE(i64);
+
+    rc = PtlEQFree(eqh);
+    if (rc != PTL_OK) {
+        ptlerr("client: PtlEQFree", rc);
+        return rc;
+    }
+
+    rc = PtlNIFini(nih);
+    if (rc != PTL_OK) {
+        ptlerr("client: PtlNIFini", rc);
+        return rc;
+    }
+    PtlFini();
+
+    return 0;
+}
+
+void wait_event(ptl_handle_eq_t eqh, ptl_event_t* ev)
+{
+    unsigned int which;
+
+    for (;;)
+        if (PtlEQPoll(&eqh, 1, 5000, ev, &which) == PTL_OK)
+            break;
+}
+
+int search(ptl_handle_ni_t nih, ptl_pt_index_t pte, ptl_handle_eq_t eqh, ptl_match_bits_t match_bits,
+           ptl_match_bits_t ignore_bits, ptl_search_op_t op, int expected_events)
+{
+    ptl_me_t mepar;
+    ptl_event_t ev;
+
+    memset(&mepar, 0, sizeof(ptl_me_t));
+    mepar.ct_handle   = PTL_CT_NONE;
+    mepar.match_bits  = match_bits;
+    mepar.ignore_bits = ignore_bits;
+    mepar.uid         = PTL_UID_ANY;
+    mepar.options     = PTL_ME_OP_PUT;
+
+    int rc = PtlMESearch(nih, pte, &mepar, op, (void*)0x5ea4c4);
+    if (rc != PTL_OK) {
+        ptlerr("server: PtlMESearch", rc);
+        return rc;
+    }
+
+    for (int i = 0; i < expected_events; ++i) {
+        wait_event(eqh, &ev);
+        if (ev.type != PTL_EVENT_SEARCH || ev.user_ptr != (void*)0x5ea4c4) {
+            fprintf(stderr, "Wrong event, got %u instead of SEARCH (%u)", ev.type, PTL_EVENT_SEARCH);
+            return 1;
+        }
+
+        if (ev.ni_fail_type == PTL_NI_NO_MATCH)
+            printf("%s 0x%lx : no match\n", op == PTL_SEARCH_ONLY ? "Search only" : "Search delete", match_bits);
+        else
+            printf("%s 0x%lx : found 0x%lx (hdr %lu)\n", op == PTL_SEARCH_ONLY ? "Search only" : "Search delete",
+                   match_bits, ev.match_bits, ev.hdr_data);
+    }
+
+    return 0;
+}
+
+int server()
+{
+    ptl_handle_ni_t nih;
+    int rc = PtlInit();
+    if (rc != PTL_OK) {
+        ptlerr("server: PtlInit", rc);
+        return rc;
+    }
+
+    rc = PtlNIInit(PTL_IFACE_DEFAULT, PTL_NI_MATCHING | PTL_NI_PHYSICAL, 2345, NULL, NULL, &nih);
+    if (rc != PTL_OK) {
+        ptlerr("server: PtlNIInit", rc);
+        return rc;
+    }
+
+    ptl_handle_eq_t eqh;
+
+    rc = PtlEQAlloc(nih, 64, &eqh);
+    if (rc != PTL_OK) {
+        ptlerr("server: PtlEQAlloc", rc);
+        return rc;
+    }
+
+    ptl_pt_index_t pte;
+
+    rc = PtlPTAlloc(nih, 0, eqh, 0, &pte);
+    if (rc != PTL_OK) {
+        ptlerr("server: PtlPTAlloc", rc);
+        return rc;
+    }
+
+    // Persistent overflow entry that accepts everything, so that each Put leaves an unexpected header
+    int64_t* overflow_buf = (int64_t*)S4BXI_SHARED_MALLOC(sizeof(int64_t));
+    ptl_me_t mepar;
+    ptl_handle_me_t meh;
+
+    memset(&mepar, 0, sizeof(ptl_me_t));
+    mepar.start       = overflow_buf;
+    mepar.length      = sizeof(int64_t);
+    mepar.ct_handle   = PTL_CT_NONE;
+    mepar.match_bits  = 0;
+    mepar.ignore_bits = ~0ULL;
+    mepar.uid         = PTL_UID_ANY;
+    mepar.options     = PTL_ME_OP_PUT | PTL_ME_EVENT_LINK_DISABLE;
+
+    rc = PtlMEAppend(nih, pte, &mepar, PTL_OVERFLOW_LIST, NULL, &meh);
+    if (rc != PTL_OK) {
+        ptlerr("server: PtlMEAppend", rc);
+        return rc;
+    }
+
+    s4bxi_barrier();
+
+    // Client waits for the ACK of each Put before reaching this barrier, so all headers are already there
+    s4bxi_barrier();
+
+    if ((rc = search(nih, pte, eqh, 42, 0, PTL_SEARCH_ONLY, 1)))
+        return rc;
+    if ((rc = search(nih, pte, eqh, 44, 0, PTL_SEARCH_ONLY, 1)))
+        return rc;
+    if ((rc = search(nih, pte, eqh, 40, 0xF, PTL_SEARCH_DELETE, PUT_NUMBER)))
+        return rc;
+    if ((rc = search(nih, pte, eqh, 42, 0, PTL_SEARCH_ONLY, 1)))
+        return rc;
+
+    // All headers were deleted by the search, so the overflow entry isn't in use anymore
+    rc = PtlMEUnlink(meh);
+    if (rc != PTL_OK) {
+        ptlerr("server: PtlMEUnlink", rc);
+        return rc;
+    }
+
+    S4BXI_SHARED_FREE(overflow_buf);
+
+    rc = PtlPTFree(nih, pte);
+    if (rc != PTL_OK) {
+        ptlerr("server: PtlPTFree", rc);
+        return rc;
+    }
+
+    rc = PtlEQFree(eqh);
+    if (rc != PTL_OK) {
+        ptlerr("server: PtlEQFree", rc);
+        return rc;
+    }
+
+    rc = PtlNIFini(nih);
+    if (rc != PTL_OK) {
+        ptlerr("server: PtlNIFini", rc);
+        return rc;
+    }
+
+    PtlFini();
+
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    // the client has a parameter (who the server is)
+    return argc > 1 ? client(argv[1]) : server();
+}
@@ -0,0 +1,240 @@
+/*
+ * Author: Julien EMMANUEL
+ * Copyright (C) 2019-2022 Bull S.A.S
+ * All rights reserved
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation,
+ * which comes with this package.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include <portals4.h>
+#include <portals4_bxiext.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+
+#define ME_NUMBER 4
+
+// Each Put should match the first entry (in append order) that accepts its match bits,
+// whether this entry is an exact one or a wildcard
+static const ptl_match_bits_t put_bits[] = {0x142, 0x200, 0x200, 0x300};
+
+void ptlerr(std::string str, int rc)
+{
+    fprintf(stderr, "%s: %s\n", str.c_str(), PtlToStr(rc, PTL_STR_ERROR));
+}
+
+int client(char* target)
+{
+    int target_nid = atoi(target);
+
+    int rc = PtlInit();
+    if (rc != PTL_OK) {
+        ptlerr("client: PtlInit", rc);
+        return rc;
+    }
+    ptl_handle_ni_t nih;
+    rc = PtlNIInit(PTL_IFACE_DEFAULT, PTL_NI_MATCHING | PTL_NI_PHYSICAL, 2345, NULL, NULL, &nih);
+    if (rc != PTL_OK) {
+        ptlerr("client: PtlNIInit", rc);
+        return rc;
+    }
+
+    ptl_md_t mdpar;
+    ptl_handle_eq_t eqh;
+    ptl_handle_md_t mdh;
+    ptl_process_t peer;
+    ptl_event_t ev;
+
+    rc = PtlEQAlloc(nih, 64, &eqh);
+    if (rc != PTL_OK) {
+        ptlerr("client: PtlEQAlloc", rc);
+        return rc;
+    }
+
+    peer.phys.nid = target_nid;
+    peer.phys.pid = 2345;
+
+    int64_t* i64 = (int64_t*)S4BXI_SHARED_MALLOC(sizeof(int64_t));
+    *i64         = 42;
+
+    mdpar.start     = i64;
+    mdpar.length    = sizeof(int64_t);
+    mdpar.eq_handle = eqh;
+    mdpar.ct_handle = PTL_CT_NONE;
+    mdpar.options   = PTL_MD_EVENT_SEND_DISABLE;
+
+    rc = PtlMDBind(nih, &mdpar, &mdh);
+    if (rc != PTL_OK) {
+        ptlerr("client: PtlMDBind", rc);
+        return rc;
+    }
+
+    s4bxi_barrier();
+
+    for (int i = 0; i < sizeof(put_bits) / sizeof(put_bits[0]); ++i) {
+        rc = PtlPut(mdh, 0, sizeof(int64_t), PTL_ACK_REQ, peer, 0, put_bits[i], 0, NULL, 0);
+        if (rc != PTL_OK) {
+            ptlerr("client: PtlPut", rc);
+            return rc;
+        }
+
+        // Wait for each ACK so that Puts reach the target in order
+        PtlEQWait(eqh, &ev);
+        if (ev.type != PTL_EVENT_ACK) {
+            fprintf(stderr, "Wrong event type, got %u instead of ACK (%u)", ev.type, PTL_EVENT_ACK);
+            return 1;
+        }
+    }
+
+    s4bxi_barrier();
+
+    rc = PtlMDRelease(mdh);
+    if (rc != PTL_OK) {
+        ptlerr("client: PtlMDRelease", rc);
+        return rc;
+    }
+
+    S4BXI_SHARED_FREE(i64);
+
+    rc = PtlEQFree(eqh);
+    if (rc != PTL_OK) {
+        ptlerr("client: PtlEQFree", rc);
+        return rc;
+    }
+
+    rc = PtlNIFini(nih);
+    if (rc != PTL_OK) {
+        ptlerr("client: PtlNIFini", rc);
+        return rc;
+    }
+    PtlFini();
+
+    return 0;
+}
+
+int server()
+{
+    unsigned int which;
+
+    ptl_handle_ni_t nih;
+    int rc = PtlInit();
+    if (rc != PTL_OK) {
+        ptlerr("server: PtlInit", rc);
+        return rc;
+    }
+
+    rc = PtlNIInit(PTL_IFACE_DEFAULT, PTL_NI_MATCHING | PTL_NI_PHYSICAL, 2345, NULL, NULL, &nih);
+    if (rc != PTL_OK) {
+        ptlerr("server: PtlNIInit", rc);
+        return rc;
+    }
+
+    ptl_handle_eq_t eqh;
+
+    rc = PtlEQAlloc(nih, 64, &eqh);
+    if (rc != PTL_OK) {
+        ptlerr("server: PtlEQAlloc", rc);
+        return rc;
+    }
+
+    ptl_pt_index_t pte;
+
+    rc = PtlPTAlloc(nih, 0, eqh, 0, &pte);
+    if (rc != PTL_OK) {
+        ptlerr("server: PtlPTAlloc", rc);
+        return rc;
+    }
+    ptl_event_t ev;
+
+    // 0: wildcard accepting 0x100 to 0x1FF
+    // 1: exact 0x142, shadowed by the wildcard appended before it
+    // 2: exact 0x200, USE_ONCE
+    // 3: catch-all wildcard
+    const ptl_match_bits_t me_bits[ME_NUMBER]   = {0x100, 0x142, 0x200, 0};
+    const ptl_match_bits_t me_ignore[ME_NUMBER] = {0xFF, 0, 0, ~0ULL};
+
+    int64_t* buf = (int64_t*)S4BXI_SHARED_MALLOC(ME_NUMBER * sizeof(int64_t));
+    ptl_me_t mepar;
+    ptl_handle_me_t meh[ME_NUMBER];
+
+    for (int i = 0; i < ME_NUMBER; ++i) {
+        memset(&mepar, 0, sizeof(ptl_me_t));
+        mepar.start       = buf + i;
+        mepar.length      = sizeof(int64_t);
+        mepar.ct_handle   = PTL_CT_NONE;
+        mepar.match_bits  = me_bits[i];
+        mepar.ignore_bits = me_ignore[i];
+        mepar.uid         = PTL_UID_ANY;
+        mepar.options     = PTL_ME_OP_PUT | PTL_ME_EVENT_LINK_DISABLE | PTL_ME_EVENT_UNLINK_DISABLE;
+        if (i == 2)
+            mepar.options |= PTL_ME_USE_ONCE;
+
+        rc = PtlMEAppend(nih, pte, &mepar, PTL_PRIORITY_LIST, (void*)(intptr_t)i, &meh[i]);
+        if (rc != PTL_OK) {
+            ptlerr("server: PtlMEAppend", rc);
+            return rc;
+        }
+    }
+
+    s4bxi_barrier();
+
+    for (int i = 0; i < sizeof(put_bits) / sizeof(put_bits[0]); ++i) {
+        for (;;) {
+            rc = PtlEQPoll(&eqh, 1, 5000, &ev, &which);
+            if (rc == PTL_OK)
+                break;
+        }
+        if (ev.type != PTL_EVENT_PUT) {
+            fprintf(stderr, "Wrong event type, got %u instead of PUT (%u)", ev.type, PTL_EVENT_PUT);
+            return 1;
+        }
+
+        printf("Put 0x%lx matched ME %ld\n", ev.match_bits, (intptr_t)ev.user_ptr);
+    }
+
+    s4bxi_barrier();
+
+    for (int i = 0; i < ME_NUMBER; ++i)
+        if (i != 2) // USE_ONCE ME was auto-unlinked
+            PtlMEUnlink(meh[i]);
+
+    S4BXI_SHARED_FREE(buf);
+
+    rc = PtlPTFree(nih, pte);
+    if (rc != PTL_OK) {
+        ptlerr("server: PtlPTFree", rc);
+        return rc;
+    }
+
+    rc = PtlEQFree(eqh);
+    if (rc != PTL_OK) {
+        ptlerr("server: PtlEQFree", rc);
+        return rc;
+    }
+
+    rc = PtlNIFini(nih);
+    if (rc != PTL_OK) {
+        ptlerr("server: PtlNIFini", rc);
+        return rc;
+    }
+
+    PtlFini();
+
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    // the client has a parameter (who the server is)
+    return argc > 1 ? client(argv[1]) : server();
+}